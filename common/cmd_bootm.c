@@ -61,6 +61,10 @@
 #include <linux/lzo.h>
 #endif /* CONFIG_LZO */
 
+#ifdef CONFIG_CMD_SFBOOT
+#include <spi_flash.h>
+#endif
+
 DECLARE_GLOBAL_DATA_PTR;
 
 #ifndef CONFIG_SYS_BOOTM_LEN
@@ -291,7 +295,22 @@ static int bootm_start(cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
 		return 1;
 	}
 
+	/*
+	 * A kernel_noload image runs wherever its data already sits, so
+	 * it never has to be copied; its entry point is an offset from
+	 * the start of that data.
+	 */
+	if (images.os.type == IH_TYPE_KERNEL_NOLOAD) {
+		if (images.os.comp != IH_COMP_NONE) {
+			puts ("kernel_noload images cannot be compressed\n");
+			return 1;
+		}
+		images.os.load = images.os.image_start;
+		images.ep += images.os.load;
+	}
+
 	if (((images.os.type == IH_TYPE_KERNEL) ||
+	     (images.os.type == IH_TYPE_KERNEL_NOLOAD) ||
 	     (images.os.type == IH_TYPE_MULTI)) &&
 	    (images.os.os == IH_OS_LINUX)) {
 		/* find ramdisk */
@@ -335,6 +354,7 @@ static int bootm_load_os(image_info_t os, ulong *load_end, int boot_progress)
 	ulong image_start = os.image_start;
 	ulong image_len = os.image_len;
 	uint unc_len = CONFIG_SYS_BOOTM_LEN;
+	int in_place = 0;
 
 	const char *type_name = genimg_get_type_name (os.type);
 
@@ -342,13 +362,14 @@ static int bootm_load_os(image_info_t os, ulong *load_end, int boot_progress)
 	case IH_COMP_NONE:
 		if (load == blob_start) {
 			printf ("   XIP %s ... ", type_name);
+			in_place = 1;
+		} else if (load == image_start) {
+			printf ("   Loading %s in place ... ", type_name);
+			in_place = 1;
 		} else {
 			printf ("   Loading %s ... ", type_name);
-
-			if (load != image_start) {
-				memmove_wd ((void *)load,
-						(void *)image_start, image_len, CHUNKSZ);
-			}
+			memmove_wd ((void *)load,
+					(void *)image_start, image_len, CHUNKSZ);
 		}
 		*load_end = load + image_len;
 		puts("OK\n");
@@ -433,7 +454,8 @@ static int bootm_load_os(image_info_t os, ulong *load_end, int boot_progress)
 	if (boot_progress)
 		show_boot_progress (7);
 
-	if ((load < blob_end) && (*load_end > blob_start)) {
+	/* Data used where it lies has not overwritten anything */
+	if (!in_place && (load < blob_end) && (*load_end > blob_start)) {
 		debug ("images.os.start = 0x%lX, images.os.end = 0x%lx\n", blob_start, blob_end);
 		debug ("images.os.load = 0x%lx, load_end = 0x%lx\n", load, *load_end);
 
@@ -581,16 +603,12 @@ int do_bootm_subcommand (cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
 /* bootm - boot application image from image in memory */
 /*******************************************************************/
 
-int do_bootm (cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
+/* relocate boot function table */
+static void bootm_relocate_boot_os(void)
 {
-	ulong		iflag;
-	ulong		load_end = 0;
-	int		ret;
-	boot_os_fn	*boot_fn;
 #ifndef CONFIG_RELOC_FIXUP_WORKS
 	static int relocated = 0;
 
-	/* relocate boot function table */
 	if (!relocated) {
 		int i;
 		for (i = 0; i < ARRAY_SIZE(boot_os); i++)
@@ -599,6 +617,16 @@ int do_bootm (cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
 		relocated = 1;
 	}
 #endif
+}
+
+int do_bootm (cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
+{
+	ulong		iflag;
+	ulong		load_end = 0;
+	int		ret;
+	boot_os_fn	*boot_fn;
+
+	bootm_relocate_boot_os();
 
 	/* determine if we have a sub command */
 	if (argc > 1) {
@@ -802,7 +830,8 @@ static int fit_check_kernel (const void *fit, int os_noffset, int verify)
 	}
 
 	show_boot_progress (106);
-	if (!fit_image_check_type (fit, os_noffset, IH_TYPE_KERNEL)) {
+	if (!fit_image_check_type (fit, os_noffset, IH_TYPE_KERNEL) &&
+	    !fit_image_check_type (fit, os_noffset, IH_TYPE_KERNEL_NOLOAD)) {
 		puts ("Not a kernel image\n");
 		show_boot_progress (-106);
 		return 0;
@@ -879,6 +908,7 @@ static void *boot_get_kernel (cmd_tbl_t *cmdtp, int flag, int argc, char *argv[]
 		/* get os_data and os_len */
 		switch (image_get_type (hdr)) {
 		case IH_TYPE_KERNEL:
+		case IH_TYPE_KERNEL_NOLOAD:
 			*os_data = image_get_data (hdr);
 			*os_len = image_get_data_size (hdr);
 			break;
@@ -1022,6 +1052,270 @@ U_BOOT_CMD(
 	"\tgo      - start OS"
 );
 
+#ifdef CONFIG_CMD_SFBOOT
+/*******************************************************************/
+/* sfboot - boot a legacy kernel image straight out of SPI flash */
+/*******************************************************************/
+#ifndef CONFIG_SF_DEFAULT_SPEED
+# define CONFIG_SF_DEFAULT_SPEED	1000000
+#endif
+#ifndef CONFIG_SF_DEFAULT_MODE
+# define CONFIG_SF_DEFAULT_MODE		SPI_MODE_3
+#endif
+#ifndef CONFIG_SFBOOT_CHUNK
+# define CONFIG_SFBOOT_CHUNK		4096
+#endif
+
+/* Reads image data from flash a chunk at a time, CRCing it on the way */
+struct sfboot_stream {
+	struct spi_flash	*flash;
+	u32			offset;
+	ulong			remaining;
+	ulong			dcrc;
+	uchar			*buf;
+};
+
+static int sfboot_fill(void *priv, unsigned char **buf, unsigned long *len)
+{
+	struct sfboot_stream *st = priv;
+	ulong chunk = min(st->remaining, (ulong)CONFIG_SFBOOT_CHUNK);
+
+	*buf = st->buf;
+	*len = chunk;
+	if (chunk == 0)
+		return 0;
+
+	if (spi_flash_read(st->flash, st->offset, chunk, st->buf) != 0) {
+		puts ("Error: SPI flash read failed\n");
+		return -1;
+	}
+	st->dcrc = crc32 (st->dcrc, st->buf, chunk);
+	st->offset += chunk;
+	st->remaining -= chunk;
+	WATCHDOG_RESET ();
+
+	return 0;
+}
+
+/*
+ * Load the kernel data following the header at offset to its load
+ * address, decompressing it on the fly and checking the data CRC in the
+ * same pass, so the compressed image is never staged in DDR.
+ */
+static int sfboot_load_os(struct spi_flash *flash, u32 offset,
+			  const image_header_t *hdr, ulong *load_end)
+{
+	struct sfboot_stream st;
+	const char *type_name = genimg_get_type_name (images.os.type);
+	ulong load = images.os.load;
+	ulong unc_len = 0;
+	ulong chunk;
+	uchar *buf;
+	int ret = 0;
+
+	st.flash = flash;
+	st.offset = offset;
+	st.remaining = image_get_data_size (hdr);
+	st.dcrc = 0;
+	st.buf = malloc (CONFIG_SFBOOT_CHUNK);
+	if (!st.buf) {
+		puts ("Error: out of memory\n");
+		return BOOTM_ERR_UNIMPLEMENTED;
+	}
+
+	switch (images.os.comp) {
+	case IH_COMP_NONE:
+		printf ("   Loading %s ... ", type_name);
+		/* Read straight into place and CRC each chunk while it's hot */
+		buf = (uchar *)load;
+		while (st.remaining) {
+			chunk = min(st.remaining, (ulong)CONFIG_SFBOOT_CHUNK);
+			if (spi_flash_read (flash, st.offset, chunk, buf) != 0) {
+				puts ("Error: SPI flash read failed\n");
+				ret = BOOTM_ERR_RESET;
+				break;
+			}
+			st.dcrc = crc32 (st.dcrc, buf, chunk);
+			st.offset += chunk;
+			st.remaining -= chunk;
+			buf += chunk;
+			WATCHDOG_RESET ();
+		}
+		unc_len = image_get_data_size (hdr);
+		break;
+#ifdef CONFIG_GZIP
+	case IH_COMP_GZIP:
+		printf ("   Uncompressing %s ... ", type_name);
+		if (gunzip_stream ((void *)load, CONFIG_SYS_BOOTM_LEN,
+				   sfboot_fill, &st, &unc_len) != 0) {
+			ret = BOOTM_ERR_RESET;
+			break;
+		}
+		/* Pull in the gzip trailer so the CRC covers all the data */
+		while (st.remaining) {
+			if (sfboot_fill (&st, &buf, &chunk) != 0) {
+				ret = BOOTM_ERR_RESET;
+				break;
+			}
+		}
+		break;
+#endif /* CONFIG_GZIP */
+	default:
+		printf ("Unimplemented compression type %d for sfboot, "
+			"use sf read and bootm\n", images.os.comp);
+		ret = BOOTM_ERR_UNIMPLEMENTED;
+		break;
+	}
+
+	free (st.buf);
+	if (ret)
+		return ret;
+
+	if (st.dcrc != image_get_dcrc (hdr)) {
+		puts ("Bad Data CRC\n");
+		show_boot_progress (-3);
+		return BOOTM_ERR_UNIMPLEMENTED;
+	}
+
+	puts ("OK\n");
+	*load_end = load + unc_len;
+	debug ("   kernel loaded at 0x%08lx, end = 0x%08lx\n", load, *load_end);
+
+	return 0;
+}
+
+int do_sfboot (cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
+{
+	struct spi_flash *flash;
+	image_header_t	*hdr;
+	ulong		iflag;
+	ulong		load_end = 0;
+	u32		offset;
+	char		*endp;
+	int		ret;
+	boot_os_fn	*boot_fn;
+
+	if (argc < 2)
+		return cmd_usage (cmdtp);
+
+	offset = simple_strtoul (argv[1], &endp, 16);
+	if (*argv[1] == 0 || *endp != 0)
+		return cmd_usage (cmdtp);
+
+	bootm_relocate_boot_os();
+
+	flash = spi_flash_probe (0, 0, CONFIG_SF_DEFAULT_SPEED,
+				 CONFIG_SF_DEFAULT_MODE);
+	if (!flash) {
+		puts ("Failed to initialize SPI flash at 0:0\n");
+		return 1;
+	}
+
+	memset ((void *)&images, 0, sizeof (images));
+	images.verify = 1;
+
+	bootm_start_lmb();
+
+	/* The header copy doubles as the image's only in-memory header */
+	hdr = &images.legacy_hdr_os_copy;
+	printf ("## Booting kernel from SPI flash at 0x%08x ...\n", offset);
+	if (spi_flash_read (flash, offset, image_get_header_size (), hdr) != 0) {
+		puts ("Error: SPI flash read failed\n");
+		goto err;
+	}
+	if (!image_check_magic (hdr)) {
+		puts ("Bad Magic Number\n");
+		show_boot_progress (-1);
+		goto err;
+	}
+	if (!image_check_hcrc (hdr)) {
+		puts ("Bad Header Checksum\n");
+		show_boot_progress (-2);
+		goto err;
+	}
+	image_print_contents (hdr);
+
+	if (!image_check_target_arch (hdr) ||
+	    image_get_type (hdr) != IH_TYPE_KERNEL) {
+		puts ("Unsupported Architecture or Image Type\n");
+		goto err;
+	}
+
+	images.legacy_hdr_os = hdr;
+	images.legacy_hdr_valid = 1;
+	images.os.type = image_get_type (hdr);
+	images.os.comp = image_get_comp (hdr);
+	images.os.os = image_get_os (hdr);
+	images.os.load = image_get_load (hdr);
+	images.ep = image_get_ep (hdr);
+
+	if (images.os.os == IH_OS_LINUX) {
+		ret = boot_get_ramdisk (argc, argv, &images, IH_INITRD_ARCH,
+				&images.rd_start, &images.rd_end);
+		if (ret) {
+			puts ("Ramdisk image is corrupt or invalid\n");
+			goto err;
+		}
+	}
+
+	iflag = disable_interrupts();
+
+	ret = sfboot_load_os (flash, offset + image_get_header_size (), hdr,
+			      &load_end);
+	spi_flash_free (flash);
+	if (ret == BOOTM_ERR_RESET) {
+		puts ("must RESET board to recover\n");
+		do_reset (cmdtp, flag, argc, argv);
+	}
+	if (ret) {
+		if (iflag)
+			enable_interrupts();
+		return 1;
+	}
+
+	lmb_reserve(&images.lmb, images.os.load, (load_end - images.os.load));
+
+	show_boot_progress (8);
+
+#ifdef CONFIG_SILENT_CONSOLE
+	if (images.os.os == IH_OS_LINUX)
+		fixup_silent_linux();
+#endif
+
+	boot_fn = boot_os[images.os.os];
+	if (boot_fn == NULL) {
+		if (iflag)
+			enable_interrupts();
+		printf ("ERROR: booting os '%s' (%d) is not supported\n",
+			genimg_get_os_name(images.os.os), images.os.os);
+		show_boot_progress (-8);
+		return 1;
+	}
+
+	arch_preboot_os();
+
+	boot_fn(0, argc, argv, &images);
+
+	show_boot_progress (-9);
+	do_reset (cmdtp, flag, argc, argv);
+
+	return 1;
+
+err:
+	spi_flash_free (flash);
+	return 1;
+}
+
+U_BOOT_CMD(
+	sfboot,	CONFIG_SYS_MAXARGS,	1,	do_sfboot,
+	"boot a kernel image straight out of SPI flash",
+	"offset [arg ...]\n"
+	"    - load the legacy kernel image at 'offset' in SPI flash 0:0,\n"
+	"\tdecompressing it on the fly, and boot it; the arguments are\n"
+	"\tpassed on as for bootm\n"
+);
+#endif /* CONFIG_CMD_SFBOOT */
+
 /*******************************************************************/
 /* bootd - boot default image */
 /*******************************************************************/
@@ -229,6 +229,101 @@ netboot_common (proto_t proto, cmd_tbl_t *cmdtp, int argc, char *argv[])
 	return rcode;
 }
 
+#if defined(CONFIG_SYS_DIRECT_SPI_FLASH_TFTP)
+#include <spi_flash.h>
+
+#ifndef CONFIG_SF_DEFAULT_SPEED
+# define CONFIG_SF_DEFAULT_SPEED	1000000
+#endif
+#ifndef CONFIG_SF_DEFAULT_MODE
+# define CONFIG_SF_DEFAULT_MODE		SPI_MODE_3
+#endif
+
+extern struct spi_flash *TftpSpiFlash;
+extern ulong TftpSpiFlashOffset;
+extern ulong TftpSpiFlashCrc;
+
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+extern int labx_preboot_forget_verified(void);
+#endif
+
+/*
+ * Download a file by TFTP straight into SPI flash 0:0, erasing and
+ * programming it block by block as the transfer proceeds.
+ */
+int do_tftpsf (cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
+{
+	struct spi_flash *flash;
+	ulong offset;
+	char *end;
+	char buf[12];
+	int size;
+
+	if (argc < 2 || argc > 3) {
+		cmd_usage(cmdtp);
+		return 1;
+	}
+
+	offset = simple_strtoul(argv[1], &end, 16);
+	if (*argv[1] == 0 || *end != 0) {
+		cmd_usage(cmdtp);
+		return 1;
+	}
+	if (argc == 3)
+		copy_filename (BootFile, argv[2], sizeof(BootFile));
+
+	flash = spi_flash_probe (0, 0, CONFIG_SF_DEFAULT_SPEED,
+				 CONFIG_SF_DEFAULT_MODE);
+	if (!flash) {
+		puts ("Failed to initialize SPI flash\n");
+		return 1;
+	}
+
+	if ((offset % flash->sector_size) != 0 || offset >= flash->size) {
+		printf ("Offset 0x%lx is not a sector boundary within flash\n",
+			offset);
+		spi_flash_free (flash);
+		return 1;
+	}
+
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+	/* Images verified at boot must be checked again after this */
+	if (labx_preboot_forget_verified()) {
+		spi_flash_free (flash);
+		return 1;
+	}
+#endif
+
+	TftpSpiFlash = flash;
+	TftpSpiFlashOffset = offset;
+	size = NetLoop(TFTP);
+	TftpSpiFlash = NULL;
+	spi_flash_free (flash);
+
+	if (size < 0)
+		return 1;
+
+	netboot_update_env();
+
+	/* The CRC was kept as the blocks were written; no need to read back */
+	sprintf (buf, "%08lx", TftpSpiFlashCrc);
+	setenv ("filecrc", buf);
+	printf ("Programmed 0x%x bytes at 0x%lx, CRC32 %s\n",
+		size, offset, buf);
+
+	return 0;
+}
+
+U_BOOT_CMD(
+	tftpsf,	3,	1,	do_tftpsf,
+	"load image via TFTP directly into SPI flash",
+	"offset [[hostIPaddr:]bootfilename]\n"
+	"    - download to SPI flash 0:0 at the sector-aligned `offset',\n"
+	"      erasing and programming it as the blocks arrive;\n"
+	"      the CRC-32 of the file is left in `filecrc'"
+);
+#endif
+
 #if defined(CONFIG_CMD_PING)
 int do_ping (cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
 {
@@ -40,6 +40,23 @@
 
 static struct spi_flash *flash;
 
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+extern int labx_preboot_forget_verified(void);
+#endif
+
+/*
+ * Called before flash is changed, so that no image is trusted on the
+ * strength of a check made before the write.
+ */
+static int spi_flash_prepare_write(void)
+{
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+	if (labx_preboot_forget_verified())
+		return 1;
+#endif
+	return 0;
+}
+
 static int do_spi_flash_probe(int argc, char *argv[])
 {
 	unsigned int bus = 0;
@@ -127,7 +144,8 @@ static int do_spi_flash_read_write(int argc, char *argv[])
 	if (strcmp(argv[0], "read") == 0)
 		ret = spi_flash_read(flash, offset, len, buf);
 	else
-		ret = spi_flash_write(flash, offset, len, buf);
+		ret = spi_flash_prepare_write() ||
+			spi_flash_write(flash, offset, len, buf);
 
 	unmap_physmem(buf, len);
 
@@ -143,6 +161,57 @@ usage:
 	return 1;
 }
 
+static int do_spi_flash_update(int argc, char *argv[])
+{
+	unsigned long addr;
+	unsigned long offset;
+	unsigned long len;
+	unsigned int sectors;
+	unsigned int skipped;
+	void *buf;
+	char *endp;
+	int ret;
+
+	if (argc < 4)
+		goto usage;
+
+	addr = simple_strtoul(argv[1], &endp, 16);
+	if (*argv[1] == 0 || *endp != 0)
+		goto usage;
+	offset = simple_strtoul(argv[2], &endp, 16);
+	if (*argv[2] == 0 || *endp != 0)
+		goto usage;
+	len = simple_strtoul(argv[3], &endp, 16);
+	if (*argv[3] == 0 || *endp != 0)
+		goto usage;
+
+	buf = map_physmem(addr, len, MAP_WRBACK);
+	if (!buf) {
+		puts("Failed to map physical memory\n");
+		return 1;
+	}
+
+	ret = spi_flash_prepare_write() ||
+		spi_flash_update(flash, offset, len, buf, &skipped);
+
+	unmap_physmem(buf, len);
+
+	if (ret) {
+		printf("SPI flash %s failed\n", argv[0]);
+		return 1;
+	}
+
+	sectors = ((offset % flash->sector_size) + len + flash->sector_size - 1) /
+		flash->sector_size;
+	printf("%u sectors updated, %u unchanged\n", sectors - skipped, skipped);
+
+	return 0;
+
+usage:
+	puts("Usage: sf update addr offset len\n");
+	return 1;
+}
+
 static int do_spi_flash_erase(int argc, char *argv[])
 {
 	unsigned long offset;
@@ -160,7 +229,8 @@ static int do_spi_flash_erase(int argc, char *argv[])
 	if (*argv[2] == 0 || *endp != 0)
 		goto usage;
 
-	ret = spi_flash_erase(flash, offset, len);
+	ret = spi_flash_prepare_write() ||
+		spi_flash_erase(flash, offset, len);
 	if (ret) {
 		printf("SPI flash %s failed\n", argv[0]);
 		return 1;
@@ -194,6 +264,8 @@ static int do_spi_flash(cmd_tbl_t *cmdtp, int flag, int argc, char *argv[])
 
 	if (strcmp(cmd, "read") == 0 || strcmp(cmd, "write") == 0)
 		return do_spi_flash_read_write(argc - 1, argv + 1);
+	if (strcmp(cmd, "update") == 0)
+		return do_spi_flash_update(argc - 1, argv + 1);
 	if (strcmp(cmd, "erase") == 0)
 		return do_spi_flash_erase(argc - 1, argv + 1);
 
@@ -486,6 +558,9 @@ U_BOOT_CMD(
 	"				  `offset' to memory at `addr'\n"
 	"sf write addr offset len	- write `len' bytes from memory\n"
 	"				  at `addr' to flash at `offset'\n"
+	"sf update addr offset len	- write `len' bytes from memory\n"
+	"				  at `addr' to flash at `offset',\n"
+	"				  skipping unchanged sectors\n"
 	"sf erase offset len		- erase `len' bytes from `offset'\n"
          
 );
@@ -134,6 +134,7 @@ static table_entry_t uimage_type[] = {
 	{	IH_TYPE_FILESYSTEM, "filesystem", "Filesystem Image",	},
 	{	IH_TYPE_FIRMWARE,   "firmware",	  "Firmware",		},
 	{	IH_TYPE_KERNEL,	    "kernel",	  "Kernel Image",	},
+	{	IH_TYPE_KERNEL_NOLOAD, "kernel_noload", "Kernel Image (no loading done)", },
 	{	IH_TYPE_MULTI,	    "multi",	  "Multi-File Image",	},
 	{	IH_TYPE_RAMDISK,    "ramdisk",	  "RAMDisk Image",	},
 	{	IH_TYPE_SCRIPT,     "script",	  "Script",		},
@@ -1914,12 +1915,12 @@ void fit_image_print (const void *fit, int image_noffset, const char *p)
 	/* Remaining, type dependent properties */
 	if ((type == IH_TYPE_KERNEL) || (type == IH_TYPE_STANDALONE) ||
 	    (type == IH_TYPE_RAMDISK) || (type == IH_TYPE_FIRMWARE) ||
-	    (type == IH_TYPE_FLATDT)) {
+	    (type == IH_TYPE_FLATDT) || (type == IH_TYPE_KERNEL_NOLOAD)) {
 		fit_image_get_arch (fit, image_noffset, &arch);
 		printf ("%s  Architecture: %s\n", p, genimg_get_arch_name (arch));
 	}
 
-	if (type == IH_TYPE_KERNEL) {
+	if ((type == IH_TYPE_KERNEL) || (type == IH_TYPE_KERNEL_NOLOAD)) {
 		fit_image_get_os (fit, image_noffset, &os);
 		printf ("%s  OS:           %s\n", p, genimg_get_os_name (os));
 	}
@@ -1934,7 +1935,8 @@ void fit_image_print (const void *fit, int image_noffset, const char *p)
 			printf ("0x%08lx\n", load);
 	}
 
-	if ((type == IH_TYPE_KERNEL) || (type == IH_TYPE_STANDALONE)) {
+	if ((type == IH_TYPE_KERNEL) || (type == IH_TYPE_STANDALONE) ||
+	    (type == IH_TYPE_KERNEL_NOLOAD)) {
 		fit_image_get_entry (fit, image_noffset, &entry);
 		printf ("%s  Entry Point:  ", p);
 		if (ret)
@@ -2402,39 +2404,110 @@ int fit_set_timestamp (void *fit, int noffset, time_t timestamp)
 	return 0;
 }
 
+/* Hash algorithms understood by calculate_hashes() */
+#define FIT_HASH_CRC32	0x01
+#define FIT_HASH_SHA1	0x02
+#define FIT_HASH_MD5	0x04
+
+/* Digests of one data block, for every algorithm asked for */
+struct fit_hashes {
+	uint32_t	crc32;
+	uint8_t		sha1[20];
+	uint8_t		md5[16];
+};
+
+static int fit_hash_algo_id (const char *algo)
+{
+	if (strcmp (algo, "crc32") == 0)
+		return FIT_HASH_CRC32;
+	if (strcmp (algo, "sha1") == 0)
+		return FIT_HASH_SHA1;
+	if (strcmp (algo, "md5") == 0)
+		return FIT_HASH_MD5;
+	return 0;
+}
+
 /**
- * calculate_hash - calculate and return hash for provided input data
+ * calculate_hashes - calculate several hashes over the same data
  * @data: pointer to the input data
  * @data_len: data length
+ * @algos: FIT_HASH_* mask of the algorithms to run
+ * @hashes: pointer to the structure receiving the digests
+ *
+ * calculate_hashes() walks the input once, in CHUNKSZ_HASH blocks, and
+ * feeds each block to every requested algorithm while it is still in
+ * the cache, rather than reading the whole image once per hash node.
+ */
+static void calculate_hashes (const void *data, int data_len, int algos,
+			struct fit_hashes *hashes)
+{
+	const unsigned char	*curr = data;
+	const unsigned char	*end = curr + data_len;
+	sha1_context		sha1_ctx;
+	struct MD5Context	md5_ctx;
+	uint32_t		crc = 0;
+	int			chunk;
+
+	if (algos & FIT_HASH_SHA1)
+		sha1_starts (&sha1_ctx);
+	if (algos & FIT_HASH_MD5)
+		MD5Init (&md5_ctx);
+
+	while (curr < end) {
+		chunk = end - curr;
+		if (chunk > CHUNKSZ_HASH)
+			chunk = CHUNKSZ_HASH;
+
+		if (algos & FIT_HASH_CRC32)
+			crc = crc32 (crc, curr, chunk);
+		if (algos & FIT_HASH_SHA1)
+			sha1_update (&sha1_ctx, (unsigned char *)curr, chunk);
+		if (algos & FIT_HASH_MD5)
+			MD5Update (&md5_ctx, curr, chunk);
+
+		curr += chunk;
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+		WATCHDOG_RESET ();
+#endif
+	}
+
+	if (algos & FIT_HASH_CRC32)
+		hashes->crc32 = cpu_to_uimage (crc);
+	if (algos & FIT_HASH_SHA1)
+		sha1_finish (&sha1_ctx, hashes->sha1);
+	if (algos & FIT_HASH_MD5)
+		MD5Final (hashes->md5, &md5_ctx);
+}
+
+/**
+ * get_hash - copy one digest out of a calculate_hashes() result
+ * @hashes: digests filled in by calculate_hashes()
  * @algo: requested hash algorithm
  * @value: pointer to the char, will hold hash value data (caller must
  * allocate enough free space)
- * value_len: length of the calculated hash
- *
- * calculate_hash() computes input data hash according to the requested algorithm.
- * Resulting hash value is placed in caller provided 'value' buffer, length
- * of the calculated hash is returned via value_len pointer argument.
+ * value_len: length of the hash
  *
  * returns:
  *     0, on success
  *    -1, when algo is unsupported
  */
-static int calculate_hash (const void *data, int data_len, const char *algo,
+static int get_hash (const struct fit_hashes *hashes, const char *algo,
 			uint8_t *value, int *value_len)
 {
-	if (strcmp (algo, "crc32") == 0 ) {
-		*((uint32_t *)value) = crc32_wd (0, data, data_len,
-							CHUNKSZ_CRC32);
-		*((uint32_t *)value) = cpu_to_uimage (*((uint32_t *)value));
+	switch (fit_hash_algo_id (algo)) {
+	case FIT_HASH_CRC32:
+		memcpy (value, &hashes->crc32, 4);
 		*value_len = 4;
-	} else if (strcmp (algo, "sha1") == 0 ) {
-		sha1_csum_wd ((unsigned char *) data, data_len,
-				(unsigned char *) value, CHUNKSZ_SHA1);
+		break;
+	case FIT_HASH_SHA1:
+		memcpy (value, hashes->sha1, 20);
 		*value_len = 20;
-	} else if (strcmp (algo, "md5") == 0 ) {
-		md5_wd ((unsigned char *)data, data_len, value, CHUNKSZ_MD5);
+		break;
+	case FIT_HASH_MD5:
+		memcpy (value, hashes->md5, 16);
 		*value_len = 16;
-	} else {
+		break;
+	default:
 		debug ("Unsupported hash alogrithm\n");
 		return -1;
 	}
@@ -2442,6 +2515,32 @@ static int calculate_hash (const void *data, int data_len, const char *algo,
 }
 
 #ifdef USE_HOSTCC
+/**
+ * calculate_hash - calculate and return hash for provided input data
+ * @data: pointer to the input data
+ * @data_len: data length
+ * @algo: requested hash algorithm
+ * @value: pointer to the char, will hold hash value data (caller must
+ * allocate enough free space)
+ * value_len: length of the calculated hash
+ *
+ * calculate_hash() computes input data hash according to the requested algorithm.
+ * Resulting hash value is placed in caller provided 'value' buffer, length
+ * of the calculated hash is returned via value_len pointer argument.
+ *
+ * returns:
+ *     0, on success
+ *    -1, when algo is unsupported
+ */
+static int calculate_hash (const void *data, int data_len, const char *algo,
+			uint8_t *value, int *value_len)
+{
+	struct fit_hashes hashes;
+
+	calculate_hashes (data, data_len, fit_hash_algo_id (algo), &hashes);
+	return get_hash (&hashes, algo, value, value_len);
+}
+
 /**
  * fit_set_hashes - process FIT component image nodes and calculate hashes
  * @fit: pointer to the FIT format image header
@@ -2619,7 +2718,8 @@ int fit_image_hash_set_value (void *fit, int noffset, uint8_t *value,
  *
  * fit_image_check_hashes() goes over component image hash nodes,
  * re-calculates each data hash and compares with the value stored in hash
- * node.
+ * node. The image data is read only once, however many hash nodes
+ * it carries.
  *
  * returns:
  *     1, if all hashes are valid
@@ -2634,9 +2734,14 @@ int fit_image_check_hashes (const void *fit, int image_noffset)
 	int		fit_value_len;
 	uint8_t		value[FIT_MAX_HASH_LEN];
 	int		value_len;
+	struct fit_hashes hashes;
+	int		algos;
 	int		noffset;
 	int		ndepth;
 	char		*err_msg = "";
+#if defined(DEBUG) && !defined(USE_HOSTCC)
+	ulong		start;
+#endif
 
 	/* Get image data and data length */
 	if (fit_image_get_data (fit, image_noffset, &data, &size)) {
@@ -2644,6 +2749,30 @@ int fit_image_check_hashes (const void *fit, int image_noffset)
 		return 0;
 	}
 
+	/*
+	 * Collect the algorithms used by the hash subnodes first, so
+	 * all of them can be computed in one pass over the data.
+	 */
+	algos = 0;
+	for (ndepth = 0, noffset = fdt_next_node (fit, image_noffset, &ndepth);
+	     (noffset >= 0) && (ndepth > 0);
+	     noffset = fdt_next_node (fit, noffset, &ndepth)) {
+		if (ndepth == 1 &&
+		    strncmp (fit_get_name(fit, noffset, NULL),
+				FIT_HASH_NODENAME,
+				strlen(FIT_HASH_NODENAME)) == 0 &&
+		    fit_image_hash_get_algo (fit, noffset, &algo) == 0)
+			algos |= fit_hash_algo_id (algo);
+	}
+
+#if defined(DEBUG) && !defined(USE_HOSTCC)
+	start = get_timer (0);
+#endif
+	calculate_hashes (data, size, algos, &hashes);
+#if defined(DEBUG) && !defined(USE_HOSTCC)
+	debug ("%lu bytes hashed in %lu ms\n", (ulong)size, get_timer (start));
+#endif
+
 	/* Process all hash subnodes of the component image node */
 	for (ndepth = 0, noffset = fdt_next_node (fit, image_noffset, &ndepth);
 	     (noffset >= 0) && (ndepth > 0);
@@ -2675,7 +2804,7 @@ int fit_image_check_hashes (const void *fit, int image_noffset)
 				goto error;
 			}
 
-			if (calculate_hash (data, size, algo, value, &value_len)) {
+			if (get_hash (&hashes, algo, value, &value_len)) {
 				err_msg = " error!\nUnsupported hash algorithm";
 				goto error;
 			}
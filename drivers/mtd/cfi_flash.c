@@ -1001,13 +1001,53 @@ out_unmap:
 #endif /* CONFIG_SYS_FLASH_USE_BUFFER_WRITE */
 
 
+#ifdef CONFIG_SYS_FLASH_CFI_MULTI_ERASE
+/*-----------------------------------------------------------------------
+ * AMD parts keep accepting sector erase commands until their sector erase
+ * timer (DQ3) expires, some 50us after the last one, and then erase all the
+ * queued sectors as a single operation. Queue the unprotected sectors which
+ * follow sect for as long as the timer stays open, and return the last one
+ * known to have been accepted; a sector written just as the timer expired
+ * is left for the caller to erase again.
+ */
+static int flash_multi_erase_ok (flash_info_t * info)
+{
+	/* DQ3 can only be trusted for a single, non-interleaved chip */
+	return (info->vendor == CFI_CMDSET_AMD_STANDARD ||
+		info->vendor == CFI_CMDSET_AMD_EXTENDED) &&
+		info->portwidth == info->chipwidth &&
+		!use_flash_status_poll (info);
+}
+
+static flash_sect_t flash_erase_queue (flash_info_t * info, flash_sect_t sect,
+				       flash_sect_t s_last)
+{
+	flash_sect_t queued = sect;
+	int flag;
+
+	flag = disable_interrupts ();
+	while (++sect <= s_last && !info->protect[sect]) {
+		if (flash_isset (info, queued, 0, AMD_STATUS_ERASE_TIMER))
+			break;
+		flash_write_cmd (info, sect, 0, AMD_CMD_ERASE_SECTOR);
+		if (flash_isset (info, queued, 0, AMD_STATUS_ERASE_TIMER))
+			break;
+		queued = sect;
+	}
+	if (flag)
+		enable_interrupts ();
+
+	return queued;
+}
+#endif /* CONFIG_SYS_FLASH_CFI_MULTI_ERASE */
+
 /*-----------------------------------------------------------------------
  */
 int flash_erase (flash_info_t * info, int s_first, int s_last)
 {
 	int rcode = 0;
 	int prot;
-	flash_sect_t sect;
+	flash_sect_t sect, last;
 	int st;
 
 	if (info->flash_id != FLASH_MAN_CFI) {
@@ -1072,6 +1112,12 @@ int flash_erase (flash_info_t * info, int s_first, int s_last)
 				break;
 			}
 
+			last = sect;
+#ifdef CONFIG_SYS_FLASH_CFI_MULTI_ERASE
+			if (flash_multi_erase_ok (info))
+				last = flash_erase_queue (info, sect, s_last);
+#endif
+
 			if (use_flash_status_poll(info)) {
 				cfiword_t cword = (cfiword_t)0xffffffffffffffffULL;
 				void *dest;
@@ -1081,8 +1127,13 @@ int flash_erase (flash_info_t * info, int s_first, int s_last)
 				flash_unmap(info, sect, 0, dest);
 			} else
 				st = flash_full_status_check(info, sect,
-							     info->erase_blk_tout,
+							     info->erase_blk_tout *
+							     (last - sect + 1),
 							     "erase");
+			for (; sect < last; sect++) {
+				if (!st && flash_verbose)
+					putc ('.');
+			}
 			if (st)
 				rcode = 1;
 			else if (flash_verbose)
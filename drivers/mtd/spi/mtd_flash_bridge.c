@@ -57,8 +57,7 @@
 
 /* Timeout, in milliseconds, associated with MTD bridge operations */
 #define MTDBRIDGE_TIMEOUT_MS     500
-#define MTDBRIDGE_TIMEOUT_SLICE  1
-#define MTDBRIDGE_TIMEOUT_WAITS  ((MTDBRIDGE_TIMEOUT_MS + MTDBRIDGE_TIMEOUT_SLICE - 1) / MTDBRIDGE_TIMEOUT_SLICE)
+#define MTDBRIDGE_TIMEOUT_TICKS  ((MTDBRIDGE_TIMEOUT_MS * CONFIG_SYS_HZ) / 1000)
 
 /* Stubbed out SPI Flash functions */
 
@@ -91,7 +90,7 @@ int spi_flash_read_common(struct spi_flash *flash, const u8 *cmd,
  * the resulting status.  Timeouts are implemented.
  */
 static int mtd_bridge_cmd(u32 offset, u32 len, u32 opcode) {
-  int timeout;
+  ulong start;
 	int rc;
 
   // Issue the requested command to the MTD bridge:
@@ -104,15 +103,17 @@ static int mtd_bridge_cmd(u32 offset, u32 len, u32 opcode) {
   MTDBRIDGE_WRITE(MTDBRIDGE_LENGTH_REG_ADDR, len);
   MTDBRIDGE_WRITE(MTDBRIDGE_COMMAND_REG_ADDR, opcode);
 
-  // Poll until a response is received from the MTD bridge daemon, or we time out
-  rc      = 0;
-  timeout = MTDBRIDGE_TIMEOUT_WAITS;
+  // Poll until a response is received from the MTD bridge daemon, or we time out.
+  // The register is polled back-to-back rather than in millisecond sleeps; the
+  // daemon typically answers well within a timer tick, and any sleep would be
+  // rounded up to a whole one.
+  rc    = 0;
+  start = get_timer(0);
   while((MTDBRIDGE_READ(MTDBRIDGE_IRQ_REG_ADDR) & MTDBRIDGE_IRQ_COMPLETE_BIT) == 0) {
-    if(!timeout--) {
+    if(get_timer(start) > MTDBRIDGE_TIMEOUT_TICKS) {
       rc = MTDBRIDGE_SR_NORESP;
       break;
     }
-    mdelay(MTDBRIDGE_TIMEOUT_SLICE);
   }
 
   // Fetch the response if there was one
@@ -120,13 +121,12 @@ static int mtd_bridge_cmd(u32 offset, u32 len, u32 opcode) {
 
   // Loop waiting if the returned code was "operation in progress", up until
   // the timeout period
-  timeout = MTDBRIDGE_TIMEOUT_WAITS;
+  start = get_timer(0);
   while((rc & MTDBRIDGE_SR_OIP) != 0) {
-    if(!timeout--) {
+    if(get_timer(start) > MTDBRIDGE_TIMEOUT_TICKS) {
       // Break loop with the "operation in progress" status pending
       break;
     }
-    mdelay(MTDBRIDGE_TIMEOUT_SLICE);
     rc = MTDBRIDGE_READ(MTDBRIDGE_STATUS_REG_ADDR);
   }
 
@@ -256,6 +256,7 @@ struct spi_flash *spi_flash_probe(unsigned int bus, unsigned int cs,
 
   // TODO - What should the size be?  This is hard-coded to 16 MiB
 	bridged_flash->size = (16 * 1024 * 1024);
+	bridged_flash->sector_size = (64 * 1024);
 
 	printf("Created MTD bridge Flash device\n");
 
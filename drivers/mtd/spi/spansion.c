@@ -329,70 +329,12 @@ static int spansion_write(struct spi_flash *flash,
 
 int spansion_erase(struct spi_flash *flash, u32 offset, size_t len)
 {
-	struct spansion_spi_flash *spsn = to_spansion_spi_flash(flash);
-	unsigned long sector_size;
-	size_t actual;
-	int ret;
-	u8 cmd[4];
-
-	/*
-	 * This function currently uses sector erase only.
-	 * probably speed things up by using bulk erase
-	 * when possible.
-	 */
-
-
-	sector_size = spsn->params->page_size * spsn->params->pages_per_sector;
-	
-
-if (offset % sector_size || len % sector_size) {
-		printf("SF: Erase offset/length not multiple of sector size\n");
-		return -1;
-	}
+	struct spi_flash_erase_info info = {
+		.ops = { { flash->sector_size, CMD_S25FLXX_SE } },
+		.chip_erase = CMD_S25FLXX_BE,
+	};
 
-	len /= sector_size;
-	cmd[0] = CMD_S25FLXX_SE;
-	cmd[2] = 0x00;
-	cmd[3] = 0x00;
-	
-
-	ret = spi_claim_bus(flash->spi);
-	if (ret) {
-		printf("SF: Unable to claim SPI bus\n");
-		return ret;
-	}
-	
-
-	ret = 0;
-	for (actual = 0; actual < len; actual++) {
-		cmd[1] = (offset + actual*sector_size)>>16;
-		//printf("Command: %02X, %02X, %02X, %02X\n", cmd[0], cmd[1], cmd[2], cmd[3]);
-		ret = spi_flash_cmd(flash->spi, CMD_S25FLXX_WREN, NULL, 0);
-		if (ret < 0) {
-			printf("SF: Enabling Write failed\n");
-			break;
-		}
-
-		ret = spi_flash_cmd_write(flash->spi, cmd, 4, NULL, 0);
-		if (ret < 0) {
-			printf("SF: SPANSION page erase failed\n");
-			break;
-		}
-
-		/* Up to 2 seconds */
-		ret = spansion_wait_ready(flash, SPI_FLASH_PAGE_ERASE_TIMEOUT);
-		if (ret < 0) {
-			printf("SF: SPANSION page erase timed out\n");
-			break;
-		}
-	}
-
-
-	printf("SF: SPANSION: Successfully erased %lu bytes @ 0x%x\n",
-	      len * sector_size, offset);
-
-	spi_release_bus(flash->spi);
-	return ret;
+	return spi_flash_cmd_erase(flash, &info, offset, len);
 }
 
 struct spi_flash *spi_flash_probe_spansion(struct spi_slave *spi, u8 *idcode)
@@ -433,8 +375,8 @@ struct spi_flash *spi_flash_probe_spansion(struct spi_slave *spi, u8 *idcode)
 	spsn->flash.read = spansion_read_fast;
 	spsn->flash.wotp = spansion_write_otp;
 	spsn->flash.rotp = spansion_read_otp;
-	spsn->flash.size = params->page_size * params->pages_per_sector
-	    * params->nr_sectors;
+	spsn->flash.sector_size = params->page_size * params->pages_per_sector;
+	spsn->flash.size = spsn->flash.sector_size * params->nr_sectors;
 
 	printf("SF: Detected %s with page size %u, total %u bytes\n",
 	      params->name, params->page_size, spsn->flash.size);
@@ -100,6 +100,127 @@ int spi_flash_read_common(struct spi_flash *flash, const u8 *cmd,
 	return ret;
 }
 
+int spi_flash_cmd_wait_ready(struct spi_flash *flash, unsigned long timeout)
+{
+	struct spi_slave *spi = flash->spi;
+	unsigned long timebase;
+	int ret;
+	u8 status = 0;
+	u8 cmd = CMD_READ_STATUS;
+
+	ret = spi_xfer(spi, 8, &cmd, NULL, SPI_XFER_BEGIN);
+	if (ret) {
+		debug("SF: Failed to send command %02x: %d\n", cmd, ret);
+		return ret;
+	}
+
+	timebase = get_timer(0);
+	do {
+		ret = spi_xfer(spi, 8, NULL, &status, 0);
+		if (ret)
+			break;
+
+		if ((status & STATUS_WIP) == 0)
+			break;
+
+	} while (get_timer(timebase) < timeout);
+
+	spi_xfer(spi, 0, NULL, NULL, SPI_XFER_END);
+
+	if (!ret && (status & STATUS_WIP) != 0) {
+		debug("SF: Timed out waiting for ready\n");
+		ret = -1;
+	}
+
+	return ret;
+}
+
+/* Pick the largest erase which starts at offset and fits within len */
+static const struct spi_flash_erase_op *
+spi_flash_erase_op(const struct spi_flash_erase_info *info, u32 offset,
+		size_t len)
+{
+	const struct spi_flash_erase_op *op = NULL;
+	int i;
+
+	for (i = 0; i < SPI_FLASH_MAX_ERASE_OPS && info->ops[i].size; i++) {
+		if ((offset & (info->ops[i].size - 1)) == 0 &&
+		    len >= info->ops[i].size)
+			op = &info->ops[i];
+	}
+
+	return op;
+}
+
+int spi_flash_cmd_erase(struct spi_flash *flash,
+		const struct spi_flash_erase_info *info, u32 offset, size_t len)
+{
+	const struct spi_flash_erase_op *op;
+	unsigned long timeout;
+	size_t cmd_len;
+	u32 erase_size;
+	int ret;
+	u8 cmd[4];
+
+	if ((offset | len) & (info->ops[0].size - 1)) {
+		printf("SF: Erase offset/length not multiple of sector size\n");
+		return -1;
+	}
+
+	if (offset > flash->size || len > flash->size - offset) {
+		printf("SF: Erase range exceeds device size\n");
+		return -1;
+	}
+
+	ret = spi_claim_bus(flash->spi);
+	if (ret) {
+		printf("SF: Unable to claim SPI bus\n");
+		return ret;
+	}
+
+	while (len) {
+		if (info->chip_erase && offset == 0 && len == flash->size) {
+			cmd[0] = info->chip_erase;
+			cmd_len = 1;
+			erase_size = len;
+			timeout = SPI_FLASH_CHIP_ERASE_TIMEOUT;
+		} else {
+			op = spi_flash_erase_op(info, offset, len);
+			cmd[0] = op->opcode;
+			cmd[1] = offset >> 16;
+			cmd[2] = offset >> 8;
+			cmd[3] = offset;
+			cmd_len = 4;
+			erase_size = op->size;
+			timeout = SPI_FLASH_SECTOR_ERASE_TIMEOUT;
+		}
+
+		ret = spi_flash_cmd(flash->spi, CMD_WRITE_ENABLE, NULL, 0);
+		if (ret < 0) {
+			printf("SF: Enabling Write failed\n");
+			break;
+		}
+
+		ret = spi_flash_cmd_write(flash->spi, cmd, cmd_len, NULL, 0);
+		if (ret < 0) {
+			printf("SF: Erase command %02x failed\n", cmd[0]);
+			break;
+		}
+
+		ret = spi_flash_cmd_wait_ready(flash, timeout);
+		if (ret < 0) {
+			printf("SF: Erase @ 0x%x timed out\n", offset);
+			break;
+		}
+
+		offset += erase_size;
+		len -= erase_size;
+	}
+
+	spi_release_bus(flash->spi);
+	return ret;
+}
+
 struct spi_flash *spi_flash_probe(unsigned int bus, unsigned int cs,
 		unsigned int max_hz, unsigned int spi_mode)
 {
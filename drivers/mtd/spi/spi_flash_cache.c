@@ -0,0 +1,113 @@
+/*
+ * SPI flash read cache
+ *
+ * A direct-mapped block cache held in a region of DDR reserved by the
+ * board, so that flash regions read more than once during a boot (CRC
+ * checks, then bootm) only cross the SPI bus once.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#include <common.h>
+#include <spi_flash.h>
+
+#ifndef CONFIG_SPI_FLASH_CACHE_BLOCK
+# define CONFIG_SPI_FLASH_CACHE_BLOCK	0x10000
+#endif
+
+#if (CONFIG_SPI_FLASH_CACHE_BLOCK & (CONFIG_SPI_FLASH_CACHE_BLOCK - 1)) != 0
+# error "CONFIG_SPI_FLASH_CACHE_BLOCK must be a power of two"
+#endif
+
+#define CACHE_LINES	(CONFIG_SPI_FLASH_CACHE_SIZE / CONFIG_SPI_FLASH_CACHE_BLOCK)
+
+/*
+ * Each tag holds the flash offset of the block in the line with the low
+ * bit set; block offsets are aligned, so a zero tag is an empty line.
+ */
+#define TAG_VALID	0x1
+
+static u32 cache_tag[CACHE_LINES];
+
+/* The cache serves a single device, identified by bus and chip select */
+static unsigned int cache_bus;
+static unsigned int cache_cs;
+static int cache_owned;
+
+static inline u8 *cache_line(unsigned int line)
+{
+	return (u8 *)CONFIG_SPI_FLASH_CACHE_ADDR +
+		(line * CONFIG_SPI_FLASH_CACHE_BLOCK);
+}
+
+static inline unsigned int cache_index(u32 block)
+{
+	return (block / CONFIG_SPI_FLASH_CACHE_BLOCK) % CACHE_LINES;
+}
+
+static int cache_owns(struct spi_flash *flash)
+{
+	return cache_owned && flash->spi->bus == cache_bus &&
+		flash->spi->cs == cache_cs;
+}
+
+int spi_flash_cache_read(struct spi_flash *flash, u32 offset, size_t len,
+		void *buf)
+{
+	u8 *dst = buf;
+	u32 block, skip, chunk;
+	unsigned int line;
+	int ret;
+
+	if (!cache_owns(flash)) {
+		memset(cache_tag, 0, sizeof(cache_tag));
+		cache_bus = flash->spi->bus;
+		cache_cs = flash->spi->cs;
+		cache_owned = 1;
+	}
+
+	while (len) {
+		block = offset & ~(CONFIG_SPI_FLASH_CACHE_BLOCK - 1);
+		skip = offset - block;
+		chunk = min(len, (size_t)(CONFIG_SPI_FLASH_CACHE_BLOCK - skip));
+		line = cache_index(block);
+
+		if (cache_tag[line] != (block | TAG_VALID)) {
+			/* A partial block at the end of the device is not cached */
+			if (block + CONFIG_SPI_FLASH_CACHE_BLOCK > flash->size)
+				return flash->read(flash, offset, len, dst);
+
+			cache_tag[line] = 0;
+			ret = flash->read(flash, block,
+					CONFIG_SPI_FLASH_CACHE_BLOCK,
+					cache_line(line));
+			if (ret)
+				return ret;
+			cache_tag[line] = block | TAG_VALID;
+		}
+
+		memcpy(dst, cache_line(line) + skip, chunk);
+		offset += chunk;
+		dst += chunk;
+		len -= chunk;
+	}
+
+	return 0;
+}
+
+void spi_flash_cache_invalidate(struct spi_flash *flash, u32 offset,
+		size_t len)
+{
+	u32 block;
+	unsigned int line;
+
+	if (!cache_owns(flash) || len == 0)
+		return;
+
+	for (block = offset & ~(CONFIG_SPI_FLASH_CACHE_BLOCK - 1);
+	     block < offset + len; block += CONFIG_SPI_FLASH_CACHE_BLOCK) {
+		line = cache_index(block);
+		if (cache_tag[line] == (block | TAG_VALID))
+			cache_tag[line] = 0;
+	}
+}
@@ -11,9 +11,15 @@
 #define SPI_FLASH_PROG_TIMEOUT		(2 * CONFIG_SYS_HZ)
 #define SPI_FLASH_PAGE_ERASE_TIMEOUT	(5 * CONFIG_SYS_HZ)
 #define SPI_FLASH_SECTOR_ERASE_TIMEOUT	(10 * CONFIG_SYS_HZ)
+#define SPI_FLASH_CHIP_ERASE_TIMEOUT	(400 * CONFIG_SYS_HZ)
 
 /* Common commands */
 #define CMD_READ_ID			0x9f
+#define CMD_WRITE_ENABLE		0x06
+#define CMD_READ_STATUS			0x05
+
+/* Common status register bits */
+#define STATUS_WIP			(1 << 0)	/* Write-in-Progress */
 
 #define CMD_READ_ARRAY_SLOW		0x03
 #define CMD_READ_ARRAY_FAST		0x0b
@@ -43,6 +49,35 @@ int spi_flash_cmd_write(struct spi_slave *spi, const u8 *cmd, size_t cmd_len,
 int spi_flash_read_common(struct spi_flash *flash, const u8 *cmd,
 		size_t cmd_len, void *data, size_t data_len);
 
+/*
+ * Erase opcodes understood by a device.  Granularities are powers of two,
+ * listed smallest first; unused entries have a size of zero.  A chip_erase
+ * opcode of zero means whole-chip erase is not used.
+ */
+#define SPI_FLASH_MAX_ERASE_OPS		3
+
+struct spi_flash_erase_op {
+	u32	size;
+	u8	opcode;
+};
+
+struct spi_flash_erase_info {
+	struct spi_flash_erase_op	ops[SPI_FLASH_MAX_ERASE_OPS];
+	u8				chip_erase;
+};
+
+/* Poll the status register until the write-in-progress bit clears */
+int spi_flash_cmd_wait_ready(struct spi_flash *flash, unsigned long timeout);
+
+/*
+ * Erase a range aligned to the smallest granularity in @info, issuing the
+ * largest erase the alignment and remaining length allow for each step and
+ * a single chip erase when the range covers the whole device. Used as
+ * common part of the ->erase() operation.
+ */
+int spi_flash_cmd_erase(struct spi_flash *flash,
+		const struct spi_flash_erase_info *info, u32 offset, size_t len);
+
 /* Manufacturer-specific probe functions */
 struct spi_flash *spi_flash_probe_spansion(struct spi_slave *spi, u8 *idcode);
 struct spi_flash *spi_flash_probe_atmel(struct spi_slave *spi, u8 *idcode);
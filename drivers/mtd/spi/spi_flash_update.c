@@ -0,0 +1,79 @@
+/*
+ * SPI flash incremental update
+ *
+ * Rewrites only the sectors of a region whose contents differ from a
+ * buffer. It goes through the generic read/erase/write entry points, so
+ * it serves the SPI flash drivers and the MTD flash bridge alike.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <spi_flash.h>
+
+int spi_flash_update(struct spi_flash *flash, u32 offset, size_t len,
+		const void *buf, unsigned int *skipped)
+{
+	u32 sector_size = flash->sector_size;
+	const u8 *src = buf;
+	u8 *sector;
+	u32 start, chunk, skip, i;
+	int need_erase;
+	int ret = 0;
+
+	*skipped = 0;
+
+	sector = malloc(sector_size);
+	if (!sector) {
+		debug("SF: Failed to allocate sector buffer\n");
+		return -1;
+	}
+
+	while (len) {
+		start = offset - (offset % sector_size);
+		skip = offset - start;
+		chunk = min(len, (size_t)(sector_size - skip));
+
+		ret = spi_flash_read(flash, start, sector_size, sector);
+		if (ret)
+			break;
+
+		if (memcmp(sector + skip, src, chunk) == 0) {
+			(*skipped)++;
+		} else {
+			/*
+			 * Programming can only clear bits, so the erase is
+			 * only needed if some bit has to go from 0 to 1.
+			 */
+			need_erase = 0;
+			for (i = 0; i < chunk; i++) {
+				if (src[i] & ~sector[skip + i]) {
+					need_erase = 1;
+					break;
+				}
+			}
+
+			memcpy(sector + skip, src, chunk);
+			if (need_erase) {
+				ret = spi_flash_erase(flash, start, sector_size);
+				if (ret)
+					break;
+				ret = spi_flash_write(flash, start,
+						sector_size, sector);
+			} else {
+				ret = spi_flash_write(flash, offset, chunk,
+						sector + skip);
+			}
+			if (ret)
+				break;
+		}
+
+		offset += chunk;
+		src += chunk;
+		len -= chunk;
+	}
+
+	free(sector);
+	return ret;
+}
@@ -27,6 +27,9 @@
 #define CMD_SST_BP		0x02	/* Byte Program */
 #define CMD_SST_AAI_WP		0xAD	/* Auto Address Increment Word Program */
 #define CMD_SST_SE		0x20	/* Sector Erase */
+#define CMD_SST_BE32		0x52	/* 32K Block Erase */
+#define CMD_SST_BE64		0xd8	/* 64K Block Erase */
+#define CMD_SST_CE		0xc7	/* Chip Erase */
 
 #define SST_SR_WIP		(1 << 0)	/* Write-in-Progress */
 #define SST_SR_WEL		(1 << 1)	/* Write enable */
@@ -250,64 +253,19 @@ sst_write(struct spi_flash *flash, u32 offset, size_t len, const void *buf)
 int
 sst_erase(struct spi_flash *flash, u32 offset, size_t len)
 {
-	unsigned long sector_size;
-	u32 start, end;
-	int ret;
-	u8 cmd[4];
-
-	/*
-	 * This function currently uses sector erase only.
-	 * Probably speed things up by using bulk erase
-	 * when possible.
-	 */
-
-	sector_size = SST_SECTOR_SIZE;
-
-	if (offset % sector_size) {
-		debug("SF: Erase offset not multiple of sector size\n");
-		return -1;
-	}
-
-	ret = spi_claim_bus(flash->spi);
-	if (ret) {
-		debug("SF: Unable to claim SPI bus\n");
-		return ret;
-	}
-
-	cmd[0] = CMD_SST_SE;
-	cmd[3] = 0;
-	start = offset;
-	end = start + len;
-
-	ret = 0;
-	while (offset < end) {
-		cmd[1] = offset >> 16;
-		cmd[2] = offset >> 8;
-		offset += sector_size;
-
-		debug("SF: erase %2x %2x %2x %2x (%x)\n", cmd[0], cmd[1],
-		      cmd[2], cmd[3], offset);
-
-		ret = sst_enable_writing(flash);
-		if (ret)
-			break;
-
-		ret = spi_flash_cmd_write(flash->spi, cmd, sizeof(cmd), NULL, 0);
-		if (ret) {
-			debug("SF: sst page erase failed\n");
-			break;
-		}
-
-		ret = sst_wait_ready(flash, SPI_FLASH_PAGE_ERASE_TIMEOUT);
-		if (ret)
-			break;
-	}
+	static const struct spi_flash_erase_info info = {
+		.ops = {
+			{ SST_SECTOR_SIZE, CMD_SST_SE },
+			{ 32 * 1024, CMD_SST_BE32 },
+			{ 64 * 1024, CMD_SST_BE64 },
+		},
+		.chip_erase = CMD_SST_CE,
+	};
 
-	debug("SF: sst: Successfully erased %lu bytes @ 0x%x\n",
-	      len * sector_size, start);
+	/* A partial trailing sector has always been erased in full */
+	len = roundup(len, SST_SECTOR_SIZE);
 
-	spi_release_bus(flash->spi);
-	return ret;
+	return spi_flash_cmd_erase(flash, &info, offset, len);
 }
 
 static int
@@ -362,6 +320,7 @@ spi_flash_probe_sst(struct spi_slave *spi, u8 *idcode)
 	stm->flash.write = sst_write;
 	stm->flash.erase = sst_erase;
 	stm->flash.read = sst_read_fast;
+	stm->flash.sector_size = SST_SECTOR_SIZE;
 	stm->flash.size = SST_SECTOR_SIZE * params->nr_sectors;
 
 	debug("SF: Detected %s with page size %u, total %u bytes\n",
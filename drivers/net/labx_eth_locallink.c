@@ -49,6 +49,21 @@
 #  error "Missing board definition of MDIO clock divisor"
 #endif
 
+#ifdef LABX_ETH_LOCALLINK_SDMA_MODE
+/* Depth of the SDMA descriptor rings; received frames land directly in
+ * NetRxPackets[], so the receive ring can be no deeper than that.
+ */
+#  ifndef LABX_ETH_LOCALLINK_TX_BDS
+#    define LABX_ETH_LOCALLINK_TX_BDS  4
+#  endif
+#  ifndef LABX_ETH_LOCALLINK_RX_BDS
+#    define LABX_ETH_LOCALLINK_RX_BDS  PKTBUFSRX
+#  endif
+#  if (LABX_ETH_LOCALLINK_RX_BDS > PKTBUFSRX)
+#    error "LABX_ETH_LOCALLINK_RX_BDS exceeds the number of receive packet buffers"
+#  endif
+#endif
+
 #ifdef LABX_ETH_LOCALLINK_SDMA_MODE
 /* SDMA registers definition */
 #define TX_NXTDESC_PTR		(LABX_ETH_LOCALLINK_SDMA_CTRL_BASEADDR + 0x00)
@@ -220,8 +235,12 @@ typedef struct cdmac_bd_t {
   unsigned long app5;
 } cdmac_bd __attribute((aligned(32))) ;
 
-static cdmac_bd	tx_bd;
-static cdmac_bd	rx_bd;
+static cdmac_bd	tx_bd[LABX_ETH_LOCALLINK_TX_BDS];
+static cdmac_bd	rx_bd[LABX_ETH_LOCALLINK_RX_BDS];
+
+/* Next descriptor to be filled for transmit, and to be examined for receive */
+static int tx_bd_tail;
+static int rx_bd_head;
 
 #endif
 
@@ -404,85 +423,110 @@ static int labx_eth_phy_ctrl(void)
   return 1;
 }
 
-/* Rx buffer is also used by FIFO mode */
+#ifdef LABX_ETH_LOCALLINK_FIFO_MODE
 static unsigned char rx_buffer[ETHER_MTU] __attribute((aligned(32)));
+#endif
 
 #ifdef LABX_ETH_LOCALLINK_SDMA_MODE
-static unsigned char tx_buffer[ETHER_MTU] __attribute((aligned(32)));
+/* Arm a receive descriptor to accept a frame into its packet buffer */
+static void labx_eth_rx_bd_arm(cdmac_bd *bd)
+{
+  bd->buf_len = ETHER_MTU;
+  bd->stat = 0;
+  bd->app5 = 0;
+
+  /* Drop any lines the stack may have dirtied in the buffer, then hand the
+   * descriptor back to the DMA engine
+   */
+  flush_cache((ulong) bd->phys_buf_p, ETHER_MTU);
+  flush_cache((ulong) bd, sizeof(cdmac_bd));
+}
 
 /* bd init */
 static void labx_eth_bd_init()
 {
-  memset((void *)&tx_bd, 0, sizeof(cdmac_bd));
-  memset((void *)&rx_bd, 0, sizeof(cdmac_bd));
+  int i;
 
-  rx_bd.phys_buf_p = &rx_buffer[0];
-  rx_bd.next_p = &rx_bd;
-  rx_bd.buf_len = ETHER_MTU;
-  invalidate_dcache_range(&rx_bd, sizeof(cdmac_bd));
+  memset((void *)tx_bd, 0, sizeof(tx_bd));
+  memset((void *)rx_bd, 0, sizeof(rx_bd));
 
+  /* Receive frames straight into the network stack's packet buffers */
+  for(i = 0; i < LABX_ETH_LOCALLINK_RX_BDS; i++) {
+    rx_bd[i].phys_buf_p = (unsigned char *) NetRxPackets[i];
+    rx_bd[i].next_p = &rx_bd[(i + 1) % LABX_ETH_LOCALLINK_RX_BDS];
+    labx_eth_rx_bd_arm(&rx_bd[i]);
+  }
+  rx_bd_head = 0;
 
-  *(unsigned int *)RX_CURDESC_PTR = &rx_bd;
-  *(unsigned int *)RX_TAILDESC_PTR = &rx_bd;
+  /* The whole ring is available to the engine from the outset */
+  *(unsigned int *)RX_CURDESC_PTR = (unsigned int) &rx_bd[0];
+  *(unsigned int *)RX_TAILDESC_PTR = (unsigned int) &rx_bd[LABX_ETH_LOCALLINK_RX_BDS - 1];
 
-  *(unsigned int *)RX_NXTDESC_PTR = &rx_bd; // setup first fd
+  for(i = 0; i < LABX_ETH_LOCALLINK_TX_BDS; i++) {
+    tx_bd[i].next_p = &tx_bd[(i + 1) % LABX_ETH_LOCALLINK_TX_BDS];
+  }
+  flush_cache((ulong) tx_bd, sizeof(tx_bd));
+  tx_bd_tail = 0;
+  *(unsigned int *)TX_CURDESC_PTR = (unsigned int) &tx_bd[0];
+}
+
+static void labx_eth_sdma_error(const char *direction)
+{
+  int i;
+
+  printf("%s DMA Error\n", direction);
+  for (i=0; i<0x44; i+=4)
+    {
+      printf("SDMA REG %08X: %08x\n", (TX_NXTDESC_PTR+i),
+	     *(volatile unsigned int*)(TX_NXTDESC_PTR+i));
+    }
 
+  // Reset and reinitialize the DMA engine
+  *(volatile unsigned int*)(DMA_CONTROL_REG) = 0x00000001;
+  while (*(volatile unsigned int*)(DMA_CONTROL_REG) & 0x00000001);
 
-  tx_bd.phys_buf_p = &tx_buffer[0];
-  tx_bd.next_p = &tx_bd;
-  invalidate_dcache_range(&tx_bd, sizeof(cdmac_bd));
-  *(unsigned int *)TX_CURDESC_PTR = &tx_bd;
+  labx_eth_bd_init();
 }
-#endif
 
-#ifdef LABX_ETH_LOCALLINK_SDMA_MODE
 static int labx_eth_send_sdma(unsigned char *buffer, int length)
 {
-  int i;
+  cdmac_bd *bd;
 
   if(labx_eth_phy_ctrl() == 0)
     return 0;
 
-  memcpy(tx_buffer, buffer, length);
-  invalidate_dcache_range(tx_buffer, length);
-
-  tx_bd.stat = BDSTAT_SOP_MASK | BDSTAT_EOP_MASK | BDSTAT_STOP_ON_END_MASK;
-  tx_bd.buf_len = length;
-  invalidate_dcache_range(&tx_bd, sizeof(cdmac_bd));
+  /* Transmit straight out of the caller's buffer; only the lines holding
+   * the frame need to reach memory first.
+   */
+  flush_cache((ulong) buffer, length);
 
-  // Wait for DMA to complete if one is active
-  while (*(volatile unsigned int*)(TX_CHNL_STS) & 0x00000002);
+  bd = &tx_bd[tx_bd_tail];
+  bd->phys_buf_p = buffer;
+  bd->buf_len = length;
+  bd->stat = BDSTAT_SOP_MASK | BDSTAT_EOP_MASK;
+  flush_cache((ulong) bd, sizeof(cdmac_bd));
+  tx_bd_tail = ((tx_bd_tail + 1) % LABX_ETH_LOCALLINK_TX_BDS);
 
-  *(volatile unsigned int *)TX_CURDESC_PTR = &tx_bd;
-  *(volatile unsigned int *)TX_TAILDESC_PTR = &tx_bd;	// DMA start
+  *(volatile unsigned int *)TX_TAILDESC_PTR = (unsigned int) bd;	// DMA start
 
+  /* The network stack reuses its transmit buffer as soon as we return, so
+   * wait for this descriptor to be consumed.
+   */
   do {
-    invalidate_dcache_range(&tx_bd, sizeof(cdmac_bd));
+    flush_cache((ulong) bd, sizeof(cdmac_bd));
 
     if ((*(volatile unsigned int*)(TX_CHNL_STS)) & 0x00000080)
       {
-	printf("TX DMA Error\n");
-	for (i=0; i<0x44; i+=4)
-	  {
-	    printf("SDMA REG %08X: %08x\n", (TX_NXTDESC_PTR+i),
-		   *(volatile unsigned int*)(TX_NXTDESC_PTR+i));
-	  }
-
-	// Reset and reinitialize the DMA engine
-	*(volatile unsigned int*)(DMA_CONTROL_REG) = 0x00000001;
-	while (*(volatile unsigned int*)(DMA_CONTROL_REG) & 0x00000001);
-
-	labx_eth_bd_init();
+	labx_eth_sdma_error("TX");
 	break;
       }
 
     if (((*(volatile unsigned int*)(TX_CHNL_STS)) & 0x00000002) == 0)
       {
-	invalidate_dcache_range(&tx_bd, sizeof(cdmac_bd));
-	//			printf("Exit loop %08X\n", (volatile int)tx_bd.stat);
+	flush_cache((ulong) bd, sizeof(cdmac_bd));
 	break;
       }
-  } while(!(((volatile unsigned int)tx_bd.stat) & BDSTAT_COMPLETED_MASK));
+  } while(!(((volatile unsigned int)bd->stat) & BDSTAT_COMPLETED_MASK));
 
   return length;
 }
@@ -490,64 +534,39 @@ static int labx_eth_send_sdma(unsigned char *buffer, int length)
 
 static int labx_eth_recv_sdma()
 {
+  cdmac_bd *bd;
   int length;
+  int total = 0;
   int i;
 
-  invalidate_dcache_range(&rx_bd, sizeof(cdmac_bd));
-
   if ((*(volatile unsigned int*)(RX_CHNL_STS)) & 0x00000080)
     {
-      printf("RX DMA Error\n");
-      for (i=0; i<0x44; i+=4)
-	{
-	  printf("SDMA REG %08X: %08x\n", (TX_NXTDESC_PTR+i),
-		 *(volatile unsigned int*)(TX_NXTDESC_PTR+i));
-	}
-
-      // Reset and reinitialize the DMA engine
-      *(volatile unsigned int*)(DMA_CONTROL_REG) = 0x00000001;
-      while (*(volatile unsigned int*)(DMA_CONTROL_REG) & 0x00000001);
-
-      labx_eth_bd_init();
+      labx_eth_sdma_error("RX");
+      return 0;
     }
-	
-  //	if(!((volatile unsigned int)rx_bd.stat & BDSTAT_COMPLETED_MASK)) {
-  if (((*(volatile unsigned int*)(RX_CHNL_STS)) & 0x00000010) == 0) {
-    return 0;
-  }
-
-  invalidate_dcache_range(&rx_bd, sizeof(cdmac_bd));
 
-  //	printf("RX CH STS: %08x, %08x, %08x, %08x, %08x\n", *(volatile unsigned int*)(RX_CHNL_STS), (int)rx_bd.stat, rx_bd.app2, rx_bd.app3, rx_bd.app4);
-
-  length = rx_bd.app5;
-  invalidate_dcache_range(rx_bd.phys_buf_p, length);
-
-  //	*(volatile unsigned int*)&rx_bd.next_p = &rx_bd;
-  *(volatile unsigned int*)&rx_bd.buf_len = ETHER_MTU;
-  *(volatile unsigned int*)&rx_bd.stat = 0;
-  *(volatile unsigned int*)&rx_bd.app5 = 0;
-
-  invalidate_dcache_range(&rx_bd, sizeof(cdmac_bd));
-#if 0	
-  if (length == 0) length = 1500;
-  printf("recv_sdma (%d)", length);
-  for (i = 0; i<length; i++)
-    {
-      if (i%8 == 0) printf("\n");
-      printf("%02X ", rx_bd.phys_buf_p[i]);
+  /* Pass up every frame the engine has completed since the last poll; each
+   * descriptor goes straight back on the ring once its frame is consumed.
+   */
+  for(i = 0; i < LABX_ETH_LOCALLINK_RX_BDS; i++) {
+    bd = &rx_bd[rx_bd_head];
+    flush_cache((ulong) bd, sizeof(cdmac_bd));
+    if(!(((volatile unsigned int)bd->stat) & BDSTAT_COMPLETED_MASK))
+      break;
+
+    length = bd->app5;
+    flush_cache((ulong) bd->phys_buf_p, length);
+    if(length > 0) {
+      NetReceive(bd->phys_buf_p, length);
+      total += length;
     }
-  printf("\n");
-#endif
-  if(length > 0) {
-    NetReceive(rx_bd.phys_buf_p, length);
-  }
 
-  *(volatile unsigned int *)RX_CURDESC_PTR = &rx_bd;
-  *(volatile unsigned int *)RX_TAILDESC_PTR = &rx_bd;
-  *(volatile unsigned int *)RX_NXTDESC_PTR = &rx_bd;
+    labx_eth_rx_bd_arm(bd);
+    *(volatile unsigned int *)RX_TAILDESC_PTR = (unsigned int) bd;
+    rx_bd_head = ((rx_bd_head + 1) % LABX_ETH_LOCALLINK_RX_BDS);
+  }
 
-  return length;
+  return total;
 }
 #endif
 
@@ -709,8 +728,10 @@ static int labx_eth_init(struct eth_device *dev, bd_t *bis)
   //	printf ("fifo isr 0x%08x, fifo_ier 0x%08x, fifo_tdfv 0x%08x, fifo_rdfo 0x%08x fifo_rlf 0x%08x\n", ll_fifo->isr, ll_fifo->ier, ll_fifo->tdfv, ll_fifo->rdfo,ll_fifo->rlf);
 #endif
 
+#ifdef LABX_ETH_LOCALLINK_FIFO_MODE
   /* Issue a LocalLink reset to make sure nothing is "stuck" */
   ll_fifo->llr = FIFO_RESET_MAGIC;
+#endif
 
   /* Configure the MDIO divisor and enable the interface to the PHY.
    * XILINX_HARD_MAC Note: The hard MDIO controller must be configured or
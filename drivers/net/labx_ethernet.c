@@ -751,8 +751,10 @@ static int labx_eth_phy_ctrl(void)
   return rc;
 }
 
-/* Rx buffer is also used by FIFO mode */
-static unsigned char rx_buffer[ETHER_MTU] __attribute((aligned(32)));
+/* Received frames are read straight into the network stack's own packet
+ * buffers, rotating through them so a burst can be drained in one pass.
+ */
+static int rx_packet_index = 0;
 
 
 
@@ -780,41 +782,67 @@ static int labx_eth_send_fifo(unsigned char *buffer, int length)
   return length;
 }
 
-static int labx_eth_recv_fifo(void)
+/* Copies a frame out of the receive data FIFO, four words at a time */
+static void labx_eth_read_fifo(int *buf, int words)
 {
-  int len, len2, i, val;
-  int *buf = (int*) &rx_buffer[0];
+  volatile int *rdfd = &ll_fifo->rdfd;
+
+  while(words >= 4) {
+    buf[0] = *rdfd;
+    buf[1] = *rdfd;
+    buf[2] = *rdfd;
+    buf[3] = *rdfd;
+    buf += 4;
+    words -= 4;
+  }
 
-  if (ll_fifo->isr & FIFO_ISR_RC) {
-    /* One or more packets have been received.  Check the read occupancy register
-     * to see how much data is ready to be processed.
-     */
-    len = ll_fifo->rlf & RLF_MASK;
-    len2 = ((len + 3) / 4);
+  while(words-- > 0) *buf++ = *rdfd;
+}
 
-    for (i = 0; i < len2; i++) {
-      val = ll_fifo->rdfd;
-      *buf++ = val ;
-    }
+static int labx_eth_recv_fifo(void)
+{
+  volatile ll_fifo_s *fifo = ll_fifo;
+  int len, words, i;
+  int total = 0;
+  uchar *packet;
+
+  if ((fifo->isr & FIFO_ISR_RC) || (fifo->rdfo != 0)) {
+    /* Acknowledge the receive-complete flag before draining, so a frame
+     * completing behind us raises it again rather than being missed.
+     */
+    fifo->isr = FIFO_ISR_RC;
 
-    /* Re-check the occupancy register; if there are still FIFO contents
-     * remaining, they are for valid packets.  Not sure if it's okay to call
-     * NetReceive() more than once for each invocation, so we'll just leave
-     * the ISR flag set instead and let the NetLoop invoke us again.
+    /* Pass every complete frame in the FIFO up to the stack, in order; any
+     * occupancy left in the data FIFO belongs to a valid packet.  The batch
+     * is bounded so that a flood cannot keep NetLoop from running.
      */
-    if(ll_fifo->rdfo == 0) ll_fifo->isr = FIFO_ISR_RC;
+    for(i = 0; (i < PKTBUFSRX) && (fifo->rdfo != 0); i++) {
+      len = fifo->rlf & RLF_MASK;
+      words = ((len + 3) / 4);
+
+      if(len > PKTSIZE_ALIGN) {
+        /* Too large for a packet buffer, discard it */
+        while(words-- > 0) (void) fifo->rdfd;
+        continue;
+      }
 
-    /* Enqueue the received packet! */
-    NetReceive (&rx_buffer[0], len);
-  } else if(ll_fifo->isr & FIFO_ISR_RX_ERR) {
-    printf("Rx error 0x%08X\n", ll_fifo->isr);
+      packet = (uchar *) NetRxPackets[rx_packet_index];
+      rx_packet_index = ((rx_packet_index + 1) % PKTBUFSRX);
+      labx_eth_read_fifo((int *) packet, words);
+
+      /* Enqueue the received packet! */
+      NetReceive(packet, len);
+      total += len;
+    }
+  } else if(fifo->isr & FIFO_ISR_RX_ERR) {
+    printf("Rx error 0x%08X\n", fifo->isr);
 
     /* A receiver error has occurred, reset the Rx logic */
-    ll_fifo->isr = FIFO_ISR_ALL;
-    ll_fifo->rdfr = FIFO_RESET_MAGIC;
+    fifo->isr = FIFO_ISR_ALL;
+    fifo->rdfr = FIFO_RESET_MAGIC;
   }
 
-    return 0;
+  return total;
 }
 
 /* FOO */
@@ -20,11 +20,27 @@
 #define XILINX_SPI_SR			0x64
 #define XILINX_SPI_CR			0x60
 #define XILINX_SPI_SSR			0x70
+#define XILINX_SPI_RX_OCY		0x78
 
 #define XILINX_SPI_SR_RX_EMPTY_MSK	0x01
 
 #define XILINX_SPI_CR_DEFAULT		(0x0086)
 
+/*
+ * Depth of the TX and RX FIFOs.  The xps_spi core has fixed 16-entry
+ * FIFOs when C_FIFO_EXIST is set; newer cores export the depth directly.
+ * A depth of 1 falls back to one byte in flight at a time.
+ */
+#ifndef CONFIG_XILINX_SPI_FIFO_DEPTH
+# if defined(XPAR_SPI_0_FIFO_DEPTH)
+#  define CONFIG_XILINX_SPI_FIFO_DEPTH XPAR_SPI_0_FIFO_DEPTH
+# elif defined(XPAR_SPI_0_FIFO_EXIST) && XPAR_SPI_0_FIFO_EXIST
+#  define CONFIG_XILINX_SPI_FIFO_DEPTH 16
+# else
+#  define CONFIG_XILINX_SPI_FIFO_DEPTH 1
+# endif
+#endif
+
 #if XPAR_XSPI_NUM_INSTANCES > 4
 # warning "The xilinx_spi driver will ignore some of your SPI peripherals!"
 #endif
@@ -122,6 +138,19 @@ void spi_release_bus(struct spi_slave *slave)
 # define CONFIG_XILINX_SPI_IDLE_VAL 0xee
 #endif
 
+/* Number of received bytes waiting in the RX FIFO, zero if it is empty */
+static inline uint xilinx_spi_rx_avail(struct xilinx_spi_slave *xilspi)
+{
+	if (readl(xilspi->base + XILINX_SPI_SR) & XILINX_SPI_SR_RX_EMPTY_MSK)
+		return 0;
+#if CONFIG_XILINX_SPI_FIFO_DEPTH > 1
+	/* The occupancy register holds the count minus one */
+	return readl(xilspi->base + XILINX_SPI_RX_OCY) + 1;
+#else
+	return 1;
+#endif
+}
+
 int spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 	     void *din, unsigned long flags)
 {
@@ -130,6 +159,7 @@ int spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 	uint bytes = bitlen / 8;
 	const uchar *txp = dout;
 	uchar *rxp = din;
+	uint tx_left, rx_left, avail;
 
 	//debug("%s: bus:%i cs:%i bitlen:%i bytes:%i flags:%lx data:%02X\n", __func__,
 		//slave->bus, slave->cs, bitlen, bytes, flags, *((uint8_t*)dout));
@@ -149,17 +179,40 @@ int spi_xfer(struct spi_slave *slave, unsigned int bitlen, const void *dout,
 	if (flags & SPI_XFER_BEGIN)
 		spi_cs_activate(slave);
 
-	while (bytes--) {
-		uchar d = txp ? *txp++ : CONFIG_XILINX_SPI_IDLE_VAL;
-//		debug("%s: tx:%x ", __func__, d);
-		writel(d, xilspi->base + XILINX_SPI_TR);
-		while (readl(xilspi->base + XILINX_SPI_SR) &
-			 XILINX_SPI_SR_RX_EMPTY_MSK)
-			;
-		d = readl(xilspi->base + XILINX_SPI_RR);
-		if (rxp)
-			*rxp++ = d;
-//		debug("rx:%x\n", d);
+	/*
+	 * Keep up to a FIFO's worth of bytes in flight so the core shifts
+	 * continuously, and drain whatever has arrived in one go.  Every
+	 * byte sent is matched by one received, so holding the number in
+	 * flight (rx_left - tx_left) below the FIFO depth means neither
+	 * FIFO can overflow.
+	 */
+	tx_left = rx_left = bytes;
+	while (rx_left) {
+		if (txp) {
+			while (tx_left &&
+			       (rx_left - tx_left) < CONFIG_XILINX_SPI_FIFO_DEPTH) {
+				writel(*txp++, xilspi->base + XILINX_SPI_TR);
+				tx_left--;
+			}
+		} else {
+			while (tx_left &&
+			       (rx_left - tx_left) < CONFIG_XILINX_SPI_FIFO_DEPTH) {
+				writel(CONFIG_XILINX_SPI_IDLE_VAL,
+				       xilspi->base + XILINX_SPI_TR);
+				tx_left--;
+			}
+		}
+
+		avail = xilinx_spi_rx_avail(xilspi);
+		rx_left -= avail;
+		if (rxp) {
+			while (avail--)
+				*rxp++ = readl(xilspi->base + XILINX_SPI_RR);
+		} else {
+			/* Write-only phase, just pop the FIFO */
+			while (avail--)
+				readl(xilspi->base + XILINX_SPI_RR);
+		}
 	}
  done:
 	if (flags & SPI_XFER_END)
@@ -624,6 +624,10 @@ int	init_timebase (void);
 int gunzip(void *, int, unsigned char *, unsigned long *);
 int zunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp,
 						int stoponerr, int offset);
+typedef int (*gunzip_fill_t)(void *priv, unsigned char **buf,
+						unsigned long *len);
+int gunzip_stream(void *dst, int dstlen, gunzip_fill_t fill, void *priv,
+						unsigned long *lenp);
 
 /* lib/net_utils.c */
 #include <net.h>
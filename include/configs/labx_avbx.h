@@ -38,6 +38,9 @@
 // and includes GPIO-checking.
 #define CONFIG_FIRMWARE_UPDATE
 
+// Service the host mailbox from its interrupt rather than by polling
+#define CONFIG_LABX_MAILBOX_IRQ XPAR_IRQ_CONTROL_UHI_MAILBOX0_SUPRV_INTERRUPT_INTR
+
 // GPIO pins to request a boot
 // delay or a firmware update.
 #define GPIO_BOOT_DELAY_BIT      17
@@ -205,6 +208,8 @@
 #define CONFIG_SPI_FLASH /* SPI Flash subsystem */
 #define CONFIG_CMD_SF /* Command line interface sf */
 #define CONFIG_SF_DEFAULT_SPEED 40000000 /* speed to run the SPI flash */
+#define CONFIG_CMD_SFBOOT /* Boot kernels straight out of SPI flash */
+#define CONFIG_SYS_DIRECT_SPI_FLASH_TFTP /* tftpsf: TFTP straight into SPI flash */
 #define CONFIG_SF_DEFAULT_MODE SPI_MODE_3 /* by default, SPI_MODE_3 is used */
 #define CONFIG_ENV_IS_IN_SPI_FLASH 1/* store the env in SPI flash */
 #define CONFIG_ENV_SPI_MAX_HZ 40000000 /* speed to run the SPI flash */
@@ -236,6 +241,13 @@
 /* Include Lab X pre-boot routines (CRC-checking, FPGA reconfiguration, etc.) */
 #define CONFIG_LABX_PREBOOT
 
+/* Remember images which pass their boot-time CRC check, and skip them on
+ * later boots until something next writes to flash */
+#define CONFIG_LABX_PREBOOT_CRC_CACHE
+
+/* Multi-table CRC-32; the pre-boot image checks spend most of their time here */
+#define CONFIG_CRC32_SLICE 8
+
 /* Data Cache */
 #ifdef XPAR_MICROBLAZE_0_USE_DCACHE
 	#define CONFIG_DCACHE
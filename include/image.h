@@ -157,6 +157,8 @@
 #define IH_TYPE_FLATDT		8	/* Binary Flat Device Tree Blob	*/
 #define IH_TYPE_KWBIMAGE	9	/* Kirkwood Boot Image		*/
 #define IH_TYPE_IMXIMAGE	10	/* Freescale IMXBoot Image	*/
+/* 11..13 are used upstream by the UBL, OMAP and AIS boot images */
+#define IH_TYPE_KERNEL_NOLOAD	14	/* OS Kernel Image, can run from any load address */
 
 /*
  * Compression Types
@@ -282,6 +284,15 @@ typedef struct bootm_headers {
 #define CHUNKSZ_SHA1 (64 * 1024)
 #endif
 
+/*
+ * FIT images carrying several hashes are digested in a single pass;
+ * keep the block small enough to stay in the data cache while each
+ * algorithm consumes it.
+ */
+#ifndef CHUNKSZ_HASH
+#define CHUNKSZ_HASH (4 * 1024)
+#endif
+
 #define uimage_to_cpu(x)		be32_to_cpu(x)
 #define cpu_to_uimage(x)		cpu_to_be32(x)
 
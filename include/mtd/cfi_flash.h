@@ -61,6 +61,7 @@
 
 #define AMD_STATUS_TOGGLE		0x40
 #define AMD_STATUS_ERROR		0x20
+#define AMD_STATUS_ERASE_TIMER		0x08
 
 #define ATM_CMD_UNLOCK_SECT		0x70
 #define ATM_CMD_SOFTLOCK_START		0x80
@@ -37,6 +37,8 @@ struct spi_flash {
 	const char	*name;
 
 	u32		size;
+	/* Smallest erasable unit, in bytes */
+	u32		sector_size;
 
 	int		(*read)(struct spi_flash *flash, u32 offset,
 				size_t len, void *buf);
@@ -54,21 +56,47 @@ struct spi_flash *spi_flash_probe(unsigned int bus, unsigned int cs,
 		unsigned int max_hz, unsigned int spi_mode);
 void spi_flash_free(struct spi_flash *flash);
 
+/*
+ * Write buf to flash, erasing and programming only the sectors whose
+ * contents differ. Data outside the range but within a touched sector is
+ * preserved. The number of sectors left untouched is returned in *skipped.
+ */
+int spi_flash_update(struct spi_flash *flash, u32 offset, size_t len,
+		const void *buf, unsigned int *skipped);
+
+#ifdef CONFIG_SPI_FLASH_CACHE
+int spi_flash_cache_read(struct spi_flash *flash, u32 offset, size_t len,
+		void *buf);
+void spi_flash_cache_invalidate(struct spi_flash *flash, u32 offset,
+		size_t len);
+#else
+static inline void spi_flash_cache_invalidate(struct spi_flash *flash,
+		u32 offset, size_t len)
+{
+}
+#endif
+
 static inline int spi_flash_read(struct spi_flash *flash, u32 offset,
 		size_t len, void *buf)
 {
+#ifdef CONFIG_SPI_FLASH_CACHE
+	return spi_flash_cache_read(flash, offset, len, buf);
+#else
 	return flash->read(flash, offset, len, buf);
+#endif
 }
 
 static inline int spi_flash_write(struct spi_flash *flash, u32 offset,
 		size_t len, const void *buf)
 {
+	spi_flash_cache_invalidate(flash, offset, len);
 	return flash->write(flash, offset, len, buf);
 }
 
 static inline int spi_flash_erase(struct spi_flash *flash, u32 offset,
 		size_t len)
 {
+	spi_flash_cache_invalidate(flash, offset, len);
 	return flash->erase(flash, offset, len);
 }
 
@@ -170,6 +170,66 @@ const uint32_t * ZEXPORT get_crc_table()
 # endif
 
 /* ========================================================================= */
+#ifdef CONFIG_CRC32_SLICE
+/*
+ * Slice-by-4 / slice-by-8 tables.  crc_slice_table[k - 1][n] is the CRC of
+ * byte n followed by k zero bytes, so four (or eight) input bytes can be
+ * folded into the CRC with one table lookup each and no serial dependency
+ * between them.  crc_table[] serves as the k = 0 table.  The entries are
+ * kept in the same little-endian form as crc_table[], which lets the word
+ * loop below index them straight from a native load on either endianness.
+ *
+ * The tables are built on first use (3 KiB or 7 KiB of BSS) rather than
+ * stored, so boards that leave CONFIG_CRC32_SLICE undefined keep the
+ * single 1 KiB table.
+ */
+#if (CONFIG_CRC32_SLICE != 4) && (CONFIG_CRC32_SLICE != 8)
+#error "CONFIG_CRC32_SLICE must be 4 or 8"
+#endif
+
+local int crc_slice_ready;
+local uint32_t crc_slice_table[CONFIG_CRC32_SLICE - 1][256];
+
+local void make_crc_slice_table(void)
+{
+  uint32_t c;
+  int n, k;
+
+#ifdef DYNAMIC_CRC_TABLE
+  if (crc_table_empty)
+    make_crc_table();
+#endif
+  for (n = 0; n < 256; n++) {
+    c = le32_to_cpu(crc_table[n]);
+    for (k = 0; k < CONFIG_CRC32_SLICE - 1; k++) {
+      c = le32_to_cpu(crc_table[c & 255]) ^ (c >> 8);
+      crc_slice_table[k][n] = tole(c);
+    }
+  }
+  crc_slice_ready = 1;
+}
+
+/*
+ * SLICE_BYTE(x, n) yields the n'th byte of the word x as it sat in memory.
+ * MicroBlaze cores built without the barrel shifter pay one cycle per bit
+ * of shift, so there the word is spilled and re-read with byte loads.
+ */
+#if defined(__microblaze__) && !defined(USE_HOSTCC) && \
+    !(defined(XPAR_MICROBLAZE_USE_BARREL) && XPAR_MICROBLAZE_USE_BARREL)
+# define SLICE_BYTE(x, n) (((const uint8_t *)&(x))[n])
+#elif __BYTE_ORDER == __LITTLE_ENDIAN
+# define SLICE_BYTE(x, n) (((x) >> (8 * (n))) & 255)
+#else
+# define SLICE_BYTE(x, n) (((x) >> (24 - 8 * (n))) & 255)
+#endif
+
+#define SLICE_TAB(k) ((k) ? crc_slice_table[(k) - 1] : crc_table)
+#define DO_SLICE4(x, k) \
+	(SLICE_TAB((k) + 3)[SLICE_BYTE(x, 0)] ^ \
+	 SLICE_TAB((k) + 2)[SLICE_BYTE(x, 1)] ^ \
+	 SLICE_TAB((k) + 1)[SLICE_BYTE(x, 2)] ^ \
+	 SLICE_TAB(k)[SLICE_BYTE(x, 3)])
+#endif /* CONFIG_CRC32_SLICE */
 
 /* No ones complement version. JFFS2 (and other things ?)
  * don't use ones compliment in their CRC calculations.
@@ -193,6 +253,31 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 b = (uint32_t *)p;
     }
 
+#ifdef CONFIG_CRC32_SLICE
+    if (!crc_slice_ready)
+      make_crc_slice_table();
+# if CONFIG_CRC32_SLICE == 8
+    rem_len = len & 7;
+    for (len >>= 3; len; --len) {
+	 /* two words per pass, eight independent lookups */
+	 uint32_t w0 = crc ^ *b++;
+	 uint32_t w1 = *b++;
+	 crc = DO_SLICE4(w0, 4) ^ DO_SLICE4(w1, 0);
+    }
+    if (rem_len & 4) {
+	 uint32_t w0 = crc ^ *b++;
+	 crc = DO_SLICE4(w0, 0);
+    }
+    rem_len &= 3;
+# else
+    rem_len = len & 3;
+    for (len >>= 2; len; --len) {
+	 uint32_t w0 = crc ^ *b++;
+	 crc = DO_SLICE4(w0, 0);
+    }
+# endif
+    --b;
+#else
     rem_len = len & 3;
     len = len >> 2;
     for (--b; len; --len) {
@@ -203,6 +288,7 @@ uint32_t ZEXPORT crc32_no_comp(uint32_t crc, const Bytef *buf, uInt len)
 	 DO_CRC(0);
 	 DO_CRC(0);
     }
+#endif
     len = rem_len;
     /* And the last few bytes */
     if (len) {
@@ -56,35 +56,130 @@ void zfree(void *x, void *addr, unsigned nb)
 	free (addr);
 }
 
-int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+/*
+ * Return the length of the gzip header at src, or -1 if it is invalid or
+ * does not fit within len bytes
+ */
+static int gunzip_header_len(unsigned char *src, unsigned long len)
 {
 	int i, flags;
 
 	/* skip header */
 	i = 10;
-	flags = src[3];
-	if (src[2] != DEFLATED || (flags & RESERVED) != 0) {
+	flags = (len > 3) ? src[3] : RESERVED;
+	if (len < 10 || src[2] != DEFLATED || (flags & RESERVED) != 0) {
 		puts ("Error: Bad gzipped data\n");
 		return (-1);
 	}
-	if ((flags & EXTRA_FIELD) != 0)
+	if ((flags & EXTRA_FIELD) != 0) {
+		if (len < 12)
+			goto out_of_data;
 		i = 12 + src[10] + (src[11] << 8);
+		if (i >= len)
+			goto out_of_data;
+	}
 	if ((flags & ORIG_NAME) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & COMMENT) != 0)
-		while (src[i++] != 0)
+		while (i < len && src[i++] != 0)
 			;
 	if ((flags & HEAD_CRC) != 0)
 		i += 2;
-	if (i >= *lenp) {
-		puts ("Error: gunzip out of data in header\n");
+	if (i >= len)
+		goto out_of_data;
+
+	return i;
+
+out_of_data:
+	puts ("Error: gunzip out of data in header\n");
+	return (-1);
+}
+
+int gunzip(void *dst, int dstlen, unsigned char *src, unsigned long *lenp)
+{
+	int i;
+
+	i = gunzip_header_len(src, *lenp);
+	if (i < 0)
 		return (-1);
-	}
 
 	return zunzip(dst, dstlen, src, lenp, 1, i);
 }
 
+/*
+ * Uncompress gzipped data which is handed over a chunk at a time by fill(),
+ * so the compressed image never has to be staged in memory as a whole.
+ * fill() returns nonzero on error, and a zero length once the input is
+ * exhausted; the gzip header must lie within the first chunk.  Input
+ * following the end of the deflate stream is left unread.
+ */
+int gunzip_stream(void *dst, int dstlen, gunzip_fill_t fill, void *priv,
+		  unsigned long *lenp)
+{
+	z_stream s;
+	unsigned char *buf;
+	unsigned long len;
+	int i, r;
+
+	if (fill(priv, &buf, &len) != 0)
+		return (-1);
+	i = gunzip_header_len(buf, len);
+	if (i < 0)
+		return (-1);
+
+	s.zalloc = zalloc;
+	s.zfree = zfree;
+#if defined(CONFIG_HW_WATCHDOG) || defined(CONFIG_WATCHDOG)
+	s.outcb = (cb_func)WATCHDOG_RESET;
+#else
+	s.outcb = Z_NULL;
+#endif	/* CONFIG_HW_WATCHDOG */
+
+	r = inflateInit2(&s, -MAX_WBITS);
+	if (r != Z_OK) {
+		printf ("Error: inflateInit2() returned %d\n", r);
+		return -1;
+	}
+	s.next_in = buf + i;
+	s.avail_in = len - i;
+	s.next_out = dst;
+	s.avail_out = dstlen;
+
+	for (;;) {
+		r = inflate(&s, Z_NO_FLUSH);
+		if (r == Z_STREAM_END)
+			break;
+		if (r != Z_OK && r != Z_BUF_ERROR) {
+			printf ("Error: inflate() returned %d\n", r);
+			break;
+		}
+
+		if (s.avail_in == 0) {
+			if (fill(priv, &buf, &len) != 0) {
+				r = Z_ERRNO;
+				break;
+			}
+			if (len == 0) {
+				puts ("Error: gunzip out of data\n");
+				r = Z_DATA_ERROR;
+				break;
+			}
+			s.next_in = buf;
+			s.avail_in = len;
+		} else if (s.avail_out == 0) {
+			puts ("Error: gunzip output exceeds buffer\n");
+			r = Z_BUF_ERROR;
+			break;
+		}
+	}
+
+	*lenp = s.next_out - (unsigned char *) dst;
+	inflateEnd(&s);
+
+	return (r == Z_STREAM_END) ? 0 : -1;
+}
+
 /*
  * Uncompress blocks compressed with zlib without headers
  */
@@ -7,12 +7,62 @@
 #include "preboot.h"
 #include "idl/FirmwareUpdate_unmarshal.h"
 #include "idl/FirmwareUpdate.h"
+#include "idl/FirmwareUpdate_type.h"
 #include "xparameters.h"
 #include <linux/types.h>
 #include <common.h>
 #include <u-boot/crc.h>
 #include "asm/microblaze_fsl.h"
 
+#ifdef CONFIG_SPI_FLASH
+#include <spi_flash.h>
+
+#ifndef CONFIG_SF_DEFAULT_SPEED
+# define CONFIG_SF_DEFAULT_SPEED	1000000
+#endif
+#ifndef CONFIG_SF_DEFAULT_MODE
+# define CONFIG_SF_DEFAULT_MODE		SPI_MODE_3
+#endif
+
+/* Number of sectors erased beyond the one currently being received during
+ * a streaming update.
+ */
+#ifndef CONFIG_FWUPDATE_ERASE_AHEAD
+# define CONFIG_FWUPDATE_ERASE_AHEAD	1
+#endif
+
+/* Size of the "clobber" region available for staging a delta update's
+ * reconstructed image, patch and base image.
+ */
+#ifndef CONFIG_FWUPDATE_CLOBBER_SIZE
+# define CONFIG_FWUPDATE_CLOBBER_SIZE	(16 << 20)
+#endif
+#endif /* CONFIG_SPI_FLASH */
+
+/* Largest number of sendWindowedDataPacket() requests the host may have
+ * outstanding before waiting for an acknowledgement.
+ */
+#ifndef CONFIG_FWUPDATE_MAX_WINDOW
+# define CONFIG_FWUPDATE_MAX_WINDOW	8
+#endif
+
+/* Time, in milliseconds, for which the host may request a firmware update
+ * or boot delay during boot.
+ */
+#ifndef CONFIG_FWUPDATE_CHECK_MS
+# define CONFIG_FWUPDATE_CHECK_MS	1000
+#endif
+
+/* Largest depth the host may configure for the event queue */
+#ifndef CONFIG_FWUPDATE_EVENT_QUEUE_MAX
+# define CONFIG_FWUPDATE_EVENT_QUEUE_MAX	16
+#endif
+
+/* Granularity, in percent, of progress events */
+#ifndef CONFIG_FWUPDATE_PROGRESS_STEP
+# define CONFIG_FWUPDATE_PROGRESS_STEP	10
+#endif
+
 #ifndef TRUE
 #define TRUE 1
 #endif
@@ -29,19 +79,40 @@
 
 #define FWUPDATE_BUFFER XPAR_DDR2_CONTROL_MPMC_BASEADDR
 
-/* Constant definitions for event types supported by the AVB platform.
-* These are hash values computed from the stream class names.
-*/
-const uint32_t NULL_EVENT            = 0x00000000;
-const uint32_t FIRMWARE_UPDATE_EVENT = 0x846C034D;
+/* The event codes (NULL_EVENT, FIRMWARE_UPDATE_EVENT, ...) are defined by
+ * FirmwareUpdate.idl, so that the host and the bootloader agree on them.
+ */
 
-FirmwareUpdate__FirmwareUpdateExecutionState *state; 
+FirmwareUpdate__FirmwareUpdateExecutionState state = UPDATE_NOT_EXECUTED;
 
 int bootDelay = FALSE;
 int firmwareUpdate = FALSE;
 int executeUpdate = FALSE;
 int queueEnabled = FALSE;
-int eventValid = FALSE;
+int deferResponse = FALSE;
+
+/* Largest payload carried by a queued event */
+#define EVENT_DATA_MAX 16
+
+/**
+ * Bounded ring of events awaiting collection by the host through the
+ * nextQueuedEvent attribute.
+ */
+typedef struct {
+  uint32_t eventCode;
+  uint32_t size;
+  uint8_t  data[EVENT_DATA_MAX];
+} QueuedEvent_t;
+
+static QueuedEvent_t eventRing[CONFIG_FWUPDATE_EVENT_QUEUE_MAX];
+static uint32_t eventHead;
+static uint32_t eventCount;
+static uint32_t eventsDropped;
+static uint32_t eventQueueDepth = CONFIG_FWUPDATE_EVENT_QUEUE_MAX;
+static FirmwareUpdate__EventQueueOverflowPolicy eventOverflowPolicy = e_DROP_OLDEST;
+
+/* Number of windowed data packets acknowledged by each response */
+static uint32_t transferWindow = 1;
 
 /**
  * Simple structure to encapsulate firmware update globals
@@ -53,10 +124,99 @@ typedef struct {
   uint8_t             *fwImageBase;
   uint8_t             *fwImagePtr;
   string_t             cmd;
+  uint32_t             dataCrc;
+  uint32_t             crcBytes;
+  uint32_t             nextSequence;
+  uint32_t             ackedSequence;
+  ulong                startTime;
+  uint32_t             receivePercent;
+#ifdef CONFIG_SPI_FLASH
+  uint8_t              bStreaming;
+  uint8_t              bStreamError;
+  struct spi_flash    *flash;
+  uint32_t             flashOffset;
+  uint32_t             bytesErased;
+  uint32_t             bytesProgrammed;
+  uint8_t              bDelta;
+  uint32_t             patchLength;
+  uint8_t             *patchBase;
+  uint8_t             *baseImage;
+  uint32_t             baseLength;
+  uint32_t             programPercent;
+#endif
 } FirmwareUpdateCtxt_t;
 
 FirmwareUpdateCtxt_t fwUpdateCtxt;
 
+/**
+ * Adds an event to the event queue, if the host has enabled it, applying
+ * the configured overflow policy when the queue is full.  The host is
+ * signalled only when the queue becomes non-empty, after which it is
+ * expected to drain every queued event.
+ *
+ * eventCode - Code identifying the type of event
+ * data      - Event payload
+ * size      - Length of the payload, at most EVENT_DATA_MAX bytes
+ */
+static void postEvent(uint32_t eventCode, const uint8_t *data, uint32_t size) {
+  QueuedEvent_t *event;
+
+  if(!queueEnabled) return;
+
+  if(eventCount >= eventQueueDepth) {
+    eventsDropped++;
+    if(eventOverflowPolicy == e_DROP_NEWEST) return;
+    eventHead = ((eventHead + 1) % CONFIG_FWUPDATE_EVENT_QUEUE_MAX);
+    eventCount--;
+  }
+
+  event = &eventRing[(eventHead + eventCount) % CONFIG_FWUPDATE_EVENT_QUEUE_MAX];
+  event->eventCode = eventCode;
+  event->size = size;
+  memcpy(event->data, data, size);
+  if(eventCount++ == 0) TrigAsyncLabXMailbox();
+}
+
+/**
+ * Posts a progress event for a stage of the update in progress.
+ *
+ * stage   - Stage the event reports on
+ * percent - Completion of the stage, in percent
+ */
+static void postProgressEvent(FirmwareUpdate__FirmwareUpdateStage stage, uint32_t percent) {
+  FirmwareUpdate__FirmwareUpdateProgressEvent progress;
+  MessageBuffer_t payload;
+  uint32_t size;
+
+  progress.stage     = stage;
+  progress.percent   = percent;
+  progress.elapsedMs = get_timer(fwUpdateCtxt.startTime);
+  size = FirmwareUpdate__FirmwareUpdateProgressEvent_marshal(payload, 0, &progress);
+  postEvent(FIRMWARE_UPDATE_PROGRESS_EVENT, payload, size);
+}
+
+/**
+ * Posts a progress event each time a stage passes another
+ * CONFIG_FWUPDATE_PROGRESS_STEP percent.
+ *
+ * stage       - Stage the event reports on
+ * done        - Amount of the stage completed
+ * total       - Total amount of work in the stage
+ * lastPercent - [IN/OUT] Percentage last reported for the stage
+ */
+static void updateProgress(FirmwareUpdate__FirmwareUpdateStage stage, uint32_t done,
+                           uint32_t total, uint32_t *lastPercent) {
+  uint32_t percent = 100;
+
+  if(done < total) percent = (done / ((total + 99) / 100));
+  if(percent > 100) percent = 100;
+  if((percent == 100) ? (*lastPercent < 100) :
+     (percent >= (*lastPercent + CONFIG_FWUPDATE_PROGRESS_STEP))) {
+    *lastPercent = percent;
+    postProgressEvent(stage, percent);
+  }
+}
+
 /**
  * Accessor for the ExecutingImageType attribute; this tells the client
  * that we are in the bootloader, not the main image.
@@ -93,10 +253,435 @@ AvbDefs__ErrorCode startFirmwareUpdate(string_t cmd,
   fwUpdateCtxt.bytesReceived         = 0;
   fwUpdateCtxt.fwImageBase           = (uint8_t*) XPAR_DDR2_CONTROL_MPMC_BASEADDR;
   fwUpdateCtxt.fwImagePtr            = fwUpdateCtxt.fwImageBase;
+  fwUpdateCtxt.dataCrc               = 0;
+  fwUpdateCtxt.crcBytes              = 0;
+  fwUpdateCtxt.nextSequence          = 0;
+  fwUpdateCtxt.ackedSequence         = 0;
+  fwUpdateCtxt.startTime             = get_timer(0);
+  fwUpdateCtxt.receivePercent        = 0;
+#ifdef CONFIG_SPI_FLASH
+  fwUpdateCtxt.programPercent        = 0;
+  fwUpdateCtxt.bStreaming            = FALSE;
+  fwUpdateCtxt.bStreamError          = FALSE;
+  fwUpdateCtxt.bDelta                = FALSE;
+#endif
   
   return(returnValue);
 }
 
+#ifdef CONFIG_SPI_FLASH
+/**
+ * Probes the SPI flash device holding the firmware images, if that has not
+ * already been done.
+ *
+ * Returns - Zero on success, nonzero if the device could not be found
+ */
+static int probeUpdateFlash(void) {
+  if(fwUpdateCtxt.flash == NULL) {
+    fwUpdateCtxt.flash = spi_flash_probe(0, 0, CONFIG_SF_DEFAULT_SPEED,
+                                         CONFIG_SF_DEFAULT_MODE);
+    if(fwUpdateCtxt.flash == NULL) {
+      puts("Failed to initialize SPI flash device at 0:0.\n");
+      return(1);
+    }
+  }
+  return(0);
+}
+
+/**
+ * Start a streaming firmware update session; the image is programmed into
+ * SPI flash sector by sector as it is received.
+ *
+ * @param cmd         - Command to be executed after all data is received
+ * @param flashOffset - Sector-aligned flash offset to program the image at
+ * @param length      - Length, in bytes, of the data image which will be sent
+ */
+AvbDefs__ErrorCode startStreamingUpdate(string_t cmd,
+                                        uint32_t flashOffset,
+                                        uint32_t length) {
+  AvbDefs__ErrorCode returnValue;
+
+  printf("Got startStreamingUpdate(\"%s\", 0x%08X, %d)\n", cmd, flashOffset, length);
+
+  if(probeUpdateFlash() != 0) return(e_EC_NOT_EXECUTED);
+
+  /* The image must start on a sector boundary and fit within the device */
+  if((flashOffset % fwUpdateCtxt.flash->sector_size) ||
+     (length > fwUpdateCtxt.flash->size) ||
+     (flashOffset > (fwUpdateCtxt.flash->size - length))) {
+    return(e_EC_INVALID_PARAMETER);
+  }
+
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+  /* Images verified at boot must be checked again once this is written */
+  if(labx_preboot_forget_verified() != 0) return(e_EC_NOT_EXECUTED);
+#endif
+
+  returnValue = startFirmwareUpdate(cmd, length);
+
+  fwUpdateCtxt.bStreaming      = TRUE;
+  fwUpdateCtxt.flashOffset     = flashOffset;
+  fwUpdateCtxt.bytesErased     = 0;
+  fwUpdateCtxt.bytesProgrammed = 0;
+
+  return(returnValue);
+}
+
+/**
+ * Accessor for the per-sector progress of a streaming update
+ */
+AvbDefs__ErrorCode get_streamingUpdateProgress(uint32_t *sectorsErased,
+                                               uint32_t *sectorsProgrammed,
+                                               uint32_t *sectorsTotal) {
+  uint32_t sectorSize;
+
+  if(fwUpdateCtxt.flash == NULL) {
+    *sectorsErased     = 0;
+    *sectorsProgrammed = 0;
+    *sectorsTotal      = 0;
+    return(e_EC_UPDATE_NOT_IN_PROGRESS);
+  }
+
+  sectorSize         = fwUpdateCtxt.flash->sector_size;
+  *sectorsErased     = (fwUpdateCtxt.bytesErased / sectorSize);
+  *sectorsProgrammed = ((fwUpdateCtxt.bytesProgrammed + sectorSize - 1) / sectorSize);
+  *sectorsTotal      = ((fwUpdateCtxt.length + sectorSize - 1) / sectorSize);
+  return(fwUpdateCtxt.bStreamError ? e_EC_NOT_EXECUTED : e_EC_SUCCESS);
+}
+
+/**
+ * Advances a streaming update as far as the received data permits: sectors
+ * are erased ahead of the write pointer, and every sector which has been
+ * completely received (or the tail of the image, once all of it has arrived)
+ * is programmed.  This is called once the response to each data packet has
+ * been posted, so flash programming overlaps the host preparing the next one.
+ *
+ * Returns - Zero on success, nonzero if a flash operation failed
+ */
+static int serviceStreamingUpdate(void) {
+  struct spi_flash *flash = fwUpdateCtxt.flash;
+  uint32_t sectorSize = flash->sector_size;
+  uint32_t imageEnd;
+  uint32_t eraseTarget;
+  uint32_t programTarget;
+
+  if(!fwUpdateCtxt.bStreaming || fwUpdateCtxt.bStreamError) return(0);
+
+  /* Keep the erase pointer ahead of the sector currently being received */
+  imageEnd    = ((fwUpdateCtxt.length + sectorSize - 1) / sectorSize) * sectorSize;
+  eraseTarget = (((fwUpdateCtxt.bytesReceived / sectorSize) + 1 + CONFIG_FWUPDATE_ERASE_AHEAD) *
+                 sectorSize);
+  if(eraseTarget > imageEnd) eraseTarget = imageEnd;
+  if(fwUpdateCtxt.bytesErased < eraseTarget) {
+    /* Erase the whole run at once so the driver can use its larger block
+     * erases wherever the run is suitably aligned
+     */
+    if(spi_flash_erase(flash, (fwUpdateCtxt.flashOffset + fwUpdateCtxt.bytesErased),
+                       (eraseTarget - fwUpdateCtxt.bytesErased)) != 0) {
+      printf("Streaming update: erase failed @ 0x%08X\n",
+             (fwUpdateCtxt.flashOffset + fwUpdateCtxt.bytesErased));
+      fwUpdateCtxt.bStreamError = TRUE;
+      return(1);
+    }
+    fwUpdateCtxt.bytesErased = eraseTarget;
+    if(fwUpdateCtxt.bytesErased == imageEnd) postProgressEvent(e_STAGE_ERASE, 100);
+  }
+
+  /* Program all completely-received sectors */
+  if(fwUpdateCtxt.bytesReceived >= fwUpdateCtxt.length) {
+    programTarget = fwUpdateCtxt.length;
+  } else programTarget = (fwUpdateCtxt.bytesReceived - (fwUpdateCtxt.bytesReceived % sectorSize));
+
+  if(programTarget > fwUpdateCtxt.bytesProgrammed) {
+    if(spi_flash_write(flash, (fwUpdateCtxt.flashOffset + fwUpdateCtxt.bytesProgrammed),
+                       (programTarget - fwUpdateCtxt.bytesProgrammed),
+                       (fwUpdateCtxt.fwImageBase + fwUpdateCtxt.bytesProgrammed)) != 0) {
+      printf("Streaming update: program failed @ 0x%08X\n",
+             (fwUpdateCtxt.flashOffset + fwUpdateCtxt.bytesProgrammed));
+      fwUpdateCtxt.bStreamError = TRUE;
+      return(1);
+    }
+    fwUpdateCtxt.bytesProgrammed = programTarget;
+    printf("Streaming update: %d of %d bytes programmed\n",
+           fwUpdateCtxt.bytesProgrammed, fwUpdateCtxt.length);
+    updateProgress(e_STAGE_PROGRAM, fwUpdateCtxt.bytesProgrammed, fwUpdateCtxt.length,
+                   &fwUpdateCtxt.programPercent);
+  }
+
+  /* The streaming session ends once the whole image has been programmed */
+  if(fwUpdateCtxt.bytesProgrammed >= fwUpdateCtxt.length) {
+    fwUpdateCtxt.bStreaming = FALSE;
+  }
+
+  return(0);
+}
+#else
+/* Streaming updates require SPI flash support */
+AvbDefs__ErrorCode startStreamingUpdate(string_t cmd,
+                                        uint32_t flashOffset,
+                                        uint32_t length) {
+  return(e_EC_NOT_EXECUTED);
+}
+
+AvbDefs__ErrorCode get_streamingUpdateProgress(uint32_t *sectorsErased,
+                                               uint32_t *sectorsProgrammed,
+                                               uint32_t *sectorsTotal) {
+  *sectorsErased     = 0;
+  *sectorsProgrammed = 0;
+  *sectorsTotal      = 0;
+  return(e_EC_NOT_EXECUTED);
+}
+#endif /* CONFIG_SPI_FLASH */
+
+/**
+ * Folds a newly-received run of image bytes into the running data CRC.  Like
+ * the data CRC in the image header, this covers only the payload following
+ * the header, so the final check needs no further pass over the image.
+ *
+ * offset - Offset of the run within the image
+ * size   - Length of the run, in bytes
+ */
+static void updateRunningCrc(uint32_t offset, uint32_t size) {
+  const uint32_t hdrLen = sizeof(image_header_t);
+  uint32_t dataEnd;
+  uint32_t end = (offset + size);
+
+  if(end <= hdrLen) return;
+  if(offset < hdrLen) offset = hdrLen;
+
+  /* The header has fully arrived by now; never run past its data size */
+  dataEnd = (hdrLen + image_get_data_size((image_header_t *)fwUpdateCtxt.fwImageBase));
+  if(end > dataEnd) end = dataEnd;
+  if(end <= offset) return;
+
+  fwUpdateCtxt.dataCrc = crc32(fwUpdateCtxt.dataCrc,
+                               (fwUpdateCtxt.fwImageBase + offset),
+                               (end - offset));
+  fwUpdateCtxt.crcBytes += (end - offset);
+}
+
+/**
+ * Accessor for the running data CRC of the image being received
+ */
+AvbDefs__ErrorCode get_runningImageCrc(uint32_t *bytesCovered,
+                                       uint32_t *crc) {
+  *bytesCovered = fwUpdateCtxt.crcBytes;
+  *crc          = fwUpdateCtxt.dataCrc;
+  return(e_EC_SUCCESS);
+}
+
+#ifdef CONFIG_SPI_FLASH
+/* Delta patch record opcodes.  A patch is a sequence of records whose fields
+ * are big-endian 32-bit words, each producing the next run of the new image:
+ *
+ *   DELTA_OP_COPY - { op, length, baseOffset } : copy from the base image
+ *   DELTA_OP_DATA - { op, length } + length literal bytes
+ */
+#define DELTA_OP_COPY (0x00000000)
+#define DELTA_OP_DATA (0x00000001)
+
+static uint32_t getPatchWord(const uint8_t *ptr) {
+  return((ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3]);
+}
+
+/**
+ * Start a delta firmware update session.  The image currently in flash at
+ * flashOffset, identified by its header's data CRC, is staged in DDR as the
+ * base; the patch subsequently sent via sendDataPacket() is applied against
+ * it to reconstruct the new image, and only the sectors which differ are
+ * rewritten.
+ *
+ * @param cmd         - Command to be executed after the image is written
+ * @param flashOffset - Sector-aligned flash offset of the base image
+ * @param baseDataCrc - Data CRC from the header of the expected base image
+ * @param patchLength - Length, in bytes, of the patch which will be sent
+ * @param length      - Length, in bytes, of the reconstructed image
+ */
+AvbDefs__ErrorCode startDeltaUpdate(string_t cmd,
+                                    uint32_t flashOffset,
+                                    uint32_t baseDataCrc,
+                                    uint32_t patchLength,
+                                    uint32_t length) {
+  AvbDefs__ErrorCode returnValue;
+  image_header_t baseHdr;
+  uint32_t sectorSize;
+  uint32_t baseLength;
+  uint32_t stageLength;
+
+  printf("Got startDeltaUpdate(\"%s\", 0x%08X, 0x%08X, %d, %d)\n",
+         cmd, flashOffset, baseDataCrc, patchLength, length);
+
+  if(probeUpdateFlash() != 0) return(e_EC_NOT_EXECUTED);
+  sectorSize = fwUpdateCtxt.flash->sector_size;
+
+  if((flashOffset % sectorSize) ||
+     (length > fwUpdateCtxt.flash->size) ||
+     (flashOffset > (fwUpdateCtxt.flash->size - length))) {
+    return(e_EC_INVALID_PARAMETER);
+  }
+
+  /* Identify the base image from its header */
+  if(spi_flash_read(fwUpdateCtxt.flash, flashOffset, sizeof(image_header_t),
+                    &baseHdr) != 0) {
+    return(e_EC_NOT_EXECUTED);
+  }
+  if(!image_check_magic(&baseHdr) || (image_get_dcrc(&baseHdr) != baseDataCrc)) {
+    puts("Delta update: base image in flash does not match\n");
+    return(e_EC_INVALID_PARAMETER);
+  }
+
+  /* The reconstructed image, the patch and the base image are staged one
+   * after another in the clobber region, each padded out to a whole number
+   * of sectors, and must all fit.  Each size is
+   * bounded first so that none of the sums below can wrap.
+   */
+  if((length > CONFIG_FWUPDATE_CLOBBER_SIZE) ||
+     (patchLength > CONFIG_FWUPDATE_CLOBBER_SIZE) ||
+     (image_get_data_size(&baseHdr) > CONFIG_FWUPDATE_CLOBBER_SIZE)) {
+    return(e_EC_INVALID_PARAMETER);
+  }
+  baseLength  = (sizeof(image_header_t) + image_get_data_size(&baseHdr));
+  stageLength = roundup(baseLength, sectorSize);
+  if((stageLength > (fwUpdateCtxt.flash->size - flashOffset)) ||
+     ((roundup(length, sectorSize) + roundup(patchLength, sectorSize) + stageLength) >
+      CONFIG_FWUPDATE_CLOBBER_SIZE)) {
+    return(e_EC_INVALID_PARAMETER);
+  }
+
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+  /* Images verified at boot must be checked again once this is written */
+  if(labx_preboot_forget_verified() != 0) return(e_EC_NOT_EXECUTED);
+#endif
+
+  returnValue = startFirmwareUpdate(cmd, length);
+
+  /* Lay out the clobber region as the reconstructed image, the patch and
+   * the base image.
+   */
+  fwUpdateCtxt.patchBase  = (fwUpdateCtxt.fwImageBase +
+                             roundup(length, sectorSize));
+  fwUpdateCtxt.baseImage  = (fwUpdateCtxt.patchBase +
+                             roundup(patchLength, sectorSize));
+  fwUpdateCtxt.baseLength = baseLength;
+
+  if(spi_flash_read(fwUpdateCtxt.flash, flashOffset, stageLength,
+                    fwUpdateCtxt.baseImage) != 0) {
+    fwUpdateCtxt.bUpdateInProgress = FALSE;
+    return(e_EC_NOT_EXECUTED);
+  }
+  if(!image_check_dcrc((image_header_t *) fwUpdateCtxt.baseImage)) {
+    puts("Delta update: base image in flash is corrupt\n");
+    fwUpdateCtxt.bUpdateInProgress = FALSE;
+    return(e_EC_CORRUPT_IMAGE);
+  }
+
+  /* Receive the patch in place of the image */
+  fwUpdateCtxt.bDelta      = TRUE;
+  fwUpdateCtxt.flashOffset = flashOffset;
+  fwUpdateCtxt.patchLength = patchLength;
+  fwUpdateCtxt.fwImagePtr  = fwUpdateCtxt.patchBase;
+
+  return(returnValue);
+}
+
+/**
+ * Reconstructs the new image from the base image and the received patch,
+ * accumulating its data CRC along the way.
+ *
+ * Returns - Zero on success, nonzero if the patch is malformed
+ */
+static int applyDeltaPatch(void) {
+  const uint8_t *patch    = fwUpdateCtxt.patchBase;
+  const uint8_t *patchEnd = (fwUpdateCtxt.patchBase + fwUpdateCtxt.patchLength);
+  uint32_t outOffset      = 0;
+  uint32_t op;
+  uint32_t runLength;
+  uint32_t baseOffset;
+
+  while(patch < patchEnd) {
+    if((patchEnd - patch) < 8) return(1);
+    op        = getPatchWord(patch);
+    runLength = getPatchWord(patch + 4);
+    patch    += 8;
+    if(runLength > (fwUpdateCtxt.length - outOffset)) return(1);
+
+    switch(op) {
+    case DELTA_OP_COPY:
+      if((patchEnd - patch) < 4) return(1);
+      baseOffset = getPatchWord(patch);
+      patch     += 4;
+      if((baseOffset > fwUpdateCtxt.baseLength) ||
+         (runLength > (fwUpdateCtxt.baseLength - baseOffset))) return(1);
+      memcpy((fwUpdateCtxt.fwImageBase + outOffset),
+             (fwUpdateCtxt.baseImage + baseOffset), runLength);
+      break;
+
+    case DELTA_OP_DATA:
+      if(runLength > (patchEnd - patch)) return(1);
+      memcpy((fwUpdateCtxt.fwImageBase + outOffset), patch, runLength);
+      patch += runLength;
+      break;
+
+    default:
+      return(1);
+    }
+
+    updateRunningCrc(outOffset, runLength);
+    outOffset += runLength;
+  }
+
+  return(outOffset != fwUpdateCtxt.length);
+}
+
+/**
+ * Rewrites only those flash sectors whose contents differ from the
+ * reconstructed image.  Data following the image in its final sector is
+ * preserved.  The image is handed over a sector at a time so that progress
+ * can be reported as the rewrite proceeds.
+ *
+ * Returns - Zero on success, nonzero if a flash operation failed
+ */
+static int writeChangedSectors(void) {
+  uint32_t sectorSize = fwUpdateCtxt.flash->sector_size;
+  uint32_t offset;
+  uint32_t chunk;
+  unsigned int unchanged;
+  uint32_t skipped    = 0;
+  uint32_t written    = 0;
+
+  for(offset = 0; offset < fwUpdateCtxt.length; offset += chunk) {
+    chunk = min(sectorSize, (fwUpdateCtxt.length - offset));
+    if(spi_flash_update(fwUpdateCtxt.flash, (fwUpdateCtxt.flashOffset + offset),
+                        chunk, (fwUpdateCtxt.fwImageBase + offset), &unchanged) != 0) {
+      printf("Delta update: rewrite failed @ 0x%08X\n",
+             (fwUpdateCtxt.flashOffset + offset));
+      return(1);
+    }
+    if(unchanged) {
+      skipped++;
+      continue;
+    }
+    written++;
+    updateProgress(e_STAGE_PROGRAM, (offset + chunk), fwUpdateCtxt.length,
+                   &fwUpdateCtxt.programPercent);
+  }
+
+  printf("Delta update: %d sectors rewritten, %d unchanged\n", written, skipped);
+  updateProgress(e_STAGE_PROGRAM, fwUpdateCtxt.length, fwUpdateCtxt.length,
+                 &fwUpdateCtxt.programPercent);
+  return(0);
+}
+#else
+/* Delta updates require SPI flash support */
+AvbDefs__ErrorCode startDeltaUpdate(string_t cmd,
+                                    uint32_t flashOffset,
+                                    uint32_t baseDataCrc,
+                                    uint32_t patchLength,
+                                    uint32_t length) {
+  return(e_EC_NOT_EXECUTED);
+}
+#endif /* CONFIG_SPI_FLASH */
+
 /**
  * Accept a Data packet for a firmware update. Must be called while we are in the process 
  * of a firmware update (i.e. startFirmwareUpdate() called first. 
@@ -106,10 +691,34 @@ AvbDefs__ErrorCode startFirmwareUpdate(string_t cmd,
 AvbDefs__ErrorCode sendDataPacket(FirmwareUpdate__FwData *data)
 {
   AvbDefs__ErrorCode returnValue = e_EC_SUCCESS;
+  uint32_t rxLength = fwUpdateCtxt.length;
 
   if(!fwUpdateCtxt.bUpdateInProgress) return e_EC_UPDATE_NOT_IN_PROGRESS;
+#ifdef CONFIG_SPI_FLASH
+  if(fwUpdateCtxt.bStreamError) return e_EC_NOT_EXECUTED;
+
+  /* A delta update receives the patch rather than the image */
+  if(fwUpdateCtxt.bDelta) rxLength = fwUpdateCtxt.patchLength;
+#endif
+
+  /* Never write past the end of the announced transfer */
+  if(data->m_size > (rxLength - fwUpdateCtxt.bytesReceived)) {
+    printf("Data packet of %d bytes overruns the %d byte transfer\n",
+           data->m_size, rxLength);
+    return(e_EC_INVALID_PARAMETER);
+  }
   memcpy(fwUpdateCtxt.fwImagePtr,data->m_data,data->m_size);
+
+#ifdef CONFIG_SPI_FLASH
+  /* For a delta update, the image CRC is accumulated later, as the image is
+   * reconstructed.
+   */
+  if(!fwUpdateCtxt.bDelta)
+#endif
+  updateRunningCrc(fwUpdateCtxt.bytesReceived, data->m_size);
   fwUpdateCtxt.bytesReceived+=data->m_size;
+  updateProgress(e_STAGE_RECEIVE, fwUpdateCtxt.bytesReceived, rxLength,
+                 &fwUpdateCtxt.receivePercent);
 
 #ifdef _LABXDEBUG
     printf("BLK[%d] : 0x%08X @ 0x%08X, sz %d\n", fwUpdateCtxt.bytesReceived,
@@ -117,10 +726,10 @@ AvbDefs__ErrorCode sendDataPacket(FirmwareUpdate__FwData *data)
          data->m_size);
 #endif
 
-  if(fwUpdateCtxt.bytesReceived >= fwUpdateCtxt.length) {
+  if(fwUpdateCtxt.bytesReceived >= rxLength) {
 
     /* We are done with the transfer, start the flash update process */
-    printf("Received all %d bytes of image\n", fwUpdateCtxt.length);
+    printf("Received all %d bytes of image\n", rxLength);
 
     /* Begin executing the update command */
     executeUpdate = TRUE;  
@@ -133,18 +742,84 @@ AvbDefs__ErrorCode sendDataPacket(FirmwareUpdate__FwData *data)
   return(returnValue);
 }
 
+/**
+ * Accessors for the data transfer window, the number of sendWindowedDataPacket()
+ * requests the host may issue before it must wait for a response.
+ */
+AvbDefs__ErrorCode get_dataTransferWindow(uint32_t *windowSize) {
+  *windowSize = transferWindow;
+  return(e_EC_SUCCESS);
+}
+
+AvbDefs__ErrorCode set_dataTransferWindow(uint32_t windowSize) {
+  if((windowSize == 0) || (windowSize > CONFIG_FWUPDATE_MAX_WINDOW)) {
+    return(e_EC_INVALID_PARAMETER);
+  }
+#if !defined(CONFIG_LABX_MAILBOX_IRQ) || defined(CONFIG_LABX_MAILBOX_ZERO_COPY)
+  /* Only the interrupt-driven receive queue can hold requests which have
+   * not yet been handled; a polled mailbox holds one, and requests read in
+   * place must not be overwritten, so the host must wait for each answer.
+   */
+  if(windowSize > 1) return(e_EC_NOT_EXECUTED);
+#endif
+  printf("Data transfer window set to %d packets\n", windowSize);
+  transferWindow = windowSize;
+  return(e_EC_SUCCESS);
+}
+
+/**
+ * Sends a sequenced packet of image data.  A packet carrying the next expected
+ * sequence number is accepted exactly as by sendDataPacket(); the response is
+ * deferred until a full window of packets has been accepted, the image is
+ * complete or an error occurs, so that one response acknowledges every packet
+ * received so far.  Any other sequence number (a packet was lost, or the host
+ * is resending after a lost response) is dropped and answered immediately.
+ *
+ * @param sequence    - Sequence number of this packet, starting from zero
+ *                      with each new update
+ * @param data        - Byte sequence constituting the packet of image data
+ * @param ackSequence - Returns the sequence number expected next, which
+ *                      acknowledges all earlier packets
+ */
+AvbDefs__ErrorCode sendWindowedDataPacket(uint32_t sequence,
+                                          FirmwareUpdate__FwData *data,
+                                          uint32_t *ackSequence) {
+  AvbDefs__ErrorCode returnValue;
+
+  if(sequence != fwUpdateCtxt.nextSequence) {
+    returnValue = e_EC_INVALID_PARAMETER;
+  } else {
+    returnValue = sendDataPacket(data);
+    if(returnValue == e_EC_SUCCESS) fwUpdateCtxt.nextSequence++;
+  }
+
+  *ackSequence = fwUpdateCtxt.nextSequence;
+  if((returnValue == e_EC_SUCCESS) && !executeUpdate &&
+     ((fwUpdateCtxt.nextSequence - fwUpdateCtxt.ackedSequence) < transferWindow)) {
+    deferResponse = TRUE;
+  } else fwUpdateCtxt.ackedSequence = fwUpdateCtxt.nextSequence;
+
+  return(returnValue);
+}
+
 int doCrcCheck(void) {
   int returnValue = 0;
+  image_header_t *hdr = (image_header_t *)fwUpdateCtxt.fwImageBase;
 
-  if(image_check_type((image_header_t *)fwUpdateCtxt.fwImageBase, IH_TYPE_KERNEL)) {
+  if(image_check_type(hdr, IH_TYPE_KERNEL)) {
     printf("   Verifying Checksum ... ");
     setenv("crcreturn", "0");
-    if (!image_check_dcrc ((image_header_t *)fwUpdateCtxt.fwImageBase)) {
+
+    /* The data CRC was accumulated as the image arrived */
+    printf("(checksum = 0x%08X) ", fwUpdateCtxt.dataCrc);
+    if ((fwUpdateCtxt.crcBytes != image_get_data_size(hdr)) ||
+        (fwUpdateCtxt.dataCrc != image_get_dcrc(hdr))) {
       printf("Bad Data CRC - please retry\n");
       setenv("crcreturn", "1");
       goto end;
     }
     printf("OK\n");
+    postProgressEvent(e_STAGE_VERIFY, 100);
     returnValue = 1;
   }
 end:
@@ -153,19 +828,45 @@ end:
 
 int executeFirmwareUpdate(void) {
 
+#ifdef CONFIG_SPI_FLASH
+  if(fwUpdateCtxt.bStreamError) {
+    state = UPDATE_NOT_EXECUTED;
+    return(1);
+  }
+
+  if(fwUpdateCtxt.bDelta && (applyDeltaPatch() != 0)) {
+    puts("Delta update: malformed patch\n");
+    state = UPDATE_CORRUPT_IMAGE;
+    return(1);
+  }
+#endif
+
   if (doCrcCheck() == FALSE) {
-    *state = UPDATE_CORRUPT_IMAGE;
+    state = UPDATE_CORRUPT_IMAGE;
+    return(1);
+  }
+
+#ifdef CONFIG_SPI_FLASH
+  if(fwUpdateCtxt.bDelta && (writeChangedSectors() != 0)) {
+    state = UPDATE_NOT_EXECUTED;
     return(1);
   }
+#endif
+
+  /* A streaming update may have been started without a follow-up command */
+  if(fwUpdateCtxt.cmd[0] == '\0') {
+    state = UPDATE_SUCCESS;
+    return(0);
+  }
 
   /* Invoke the HUSH parser on the command */
   if(parse_string_outer(fwUpdateCtxt.cmd,
                         (FLAG_PARSE_SEMICOLON | FLAG_EXIT_FROM_LOOP)) != 0) {
-    *state = UPDATE_NOT_EXECUTED;
+    state = UPDATE_NOT_EXECUTED;
     return(1);
   }
    
-  *state = UPDATE_SUCCESS;
+  state = UPDATE_SUCCESS;
   return(0);
 }
 
@@ -211,17 +912,61 @@ AvbDefs__ErrorCode set_eventQueueEnabled(uint32_t eventCode,
   return(e_EC_SUCCESS);
 }
 
+AvbDefs__ErrorCode get_eventQueueDepth(uint32_t eventCode,
+                                       uint32_t *depth) {
+  *depth = eventQueueDepth;
+  return(e_EC_SUCCESS);
+}
+
+AvbDefs__ErrorCode set_eventQueueDepth(uint32_t eventCode,
+                                       uint32_t depth) {
+  if((depth == 0) || (depth > CONFIG_FWUPDATE_EVENT_QUEUE_MAX)) {
+    return(e_EC_INVALID_PARAMETER);
+  }
+
+  /* Discard the oldest events if the queue no longer holds them all */
+  while(eventCount > depth) {
+    eventHead = ((eventHead + 1) % CONFIG_FWUPDATE_EVENT_QUEUE_MAX);
+    eventCount--;
+    eventsDropped++;
+  }
+  eventQueueDepth = depth;
+  return(e_EC_SUCCESS);
+}
+
+AvbDefs__ErrorCode get_eventQueueOverflowPolicy(uint32_t eventCode,
+                                                FirmwareUpdate__EventQueueOverflowPolicy *policy) {
+  *policy = eventOverflowPolicy;
+  return(e_EC_SUCCESS);
+}
+
+AvbDefs__ErrorCode set_eventQueueOverflowPolicy(uint32_t eventCode,
+                                                FirmwareUpdate__EventQueueOverflowPolicy policy) {
+  if((policy != e_DROP_OLDEST) && (policy != e_DROP_NEWEST)) {
+    return(e_EC_INVALID_PARAMETER);
+  }
+  eventOverflowPolicy = policy;
+  return(e_EC_SUCCESS);
+}
+
 AvbDefs__ErrorCode get_nextQueuedEvent(FirmwareUpdate__GenericEvent *event) { 
   int returnValue = e_EC_SUCCESS;
+  QueuedEvent_t *queued;
 
-  if(eventValid) { 
-    event->eventCode = FIRMWARE_UPDATE_EVENT;
-    event->data.m_data[0] = *state;
-    event->data.m_size = 0x01;
-    eventValid = FALSE;
-    printf("Sending firmware update event status for %08X of 0x%02X\n", event->eventCode, *state);
+  if(eventCount > 0) { 
+    queued = &eventRing[eventHead];
+    event->eventCode = queued->eventCode;
+    event->data.m_size = queued->size;
+    memcpy(event->data.m_data, queued->data, queued->size);
+    eventHead = ((eventHead + 1) % CONFIG_FWUPDATE_EVENT_QUEUE_MAX);
+    eventCount--;
+#ifdef _LABXDEBUG
+    printf("Sending event %08X, %d still queued, %d dropped\n", event->eventCode,
+           eventCount, eventsDropped);
+#endif
   } else {
       event->eventCode = NULL_EVENT;
+      event->data.m_size = 0;
   }
 
   return(returnValue); 
@@ -243,7 +988,14 @@ int DoFirmwareUpdate(void)
   uint32_t respSize;
 
   /* Continuously read request messages from the host and unmarshal them */
+#ifdef CONFIG_LABX_MAILBOX_ZERO_COPY
+  /* Unmarshal each request in place in mailbox message RAM */
+  uint8_t *request;
+
+  while ((request = PeekLabXMailbox(&reqSize, TRUE)) != NULL) {
+#else
   while (ReadLabXMailbox(request, &reqSize, TRUE)) {
+#endif
     /* Unmarshal the received request */
     switch(getClassCode_req(request)) {
 	
@@ -270,11 +1022,16 @@ int DoFirmwareUpdate(void)
       setLength_resp(response, getPayloadOffset_resp(response));
     }
 
-    /* Write the response out to the mailbox */
-
+    /* Write the response out to the mailbox, unless this was a windowed data
+     * packet which a later response will acknowledge along with the others
+     */
+    if(deferResponse) {
+      deferResponse = FALSE;
+    } else {
       respSize = getLength_resp(response);
       setLength_resp(response, respSize);
       WriteLabXMailbox(response, respSize);
+    }
 
 #ifdef _LABXDEBUG
       printf("Response Length: 0x%02X\n", respSize);
@@ -286,13 +1043,22 @@ int DoFirmwareUpdate(void)
       printf("]\n");
 #endif
 
+#ifdef CONFIG_SPI_FLASH
+    /* The host already has its response; erase and program any sectors
+     * completed by this packet while it prepares the next one.
+     */
+    serviceStreamingUpdate();
+#endif
+
     if(executeUpdate) {
+      uint8_t eventData;
+
       executeFirmwareUpdate();
       executeUpdate = FALSE;
-      if(queueEnabled) {
-        eventValid = TRUE;
-        TrigAsyncLabXMailbox();
-      }
+
+      /* Report the outcome of the update */
+      eventData = state;
+      postEvent(FIRMWARE_UPDATE_EVENT, &eventData, sizeof(eventData));
     } 
 
   /* Re-set the max request size for the next iteration */
@@ -312,7 +1078,11 @@ int DoFirmwareUpdate(void)
 int CheckFirmwareUpdate(void)
 {
   int doUpdate = 0;
+  int gotRequest = 0;
+  ulong checkStart;
+#ifdef _LABXDEBUG
   int i;
+#endif
 
   uint32_t reqSize = sizeof(RequestMessageBuffer_t);
   uint32_t respSize;
@@ -348,14 +1118,15 @@ int CheckFirmwareUpdate(void)
 #endif
   }
 
-  /* Check the mailbox every quarter of a second for a
-     total of 1 second to enter into firmware update */
+  /* Watch the mailbox for up to CONFIG_FWUPDATE_CHECK_MS for a request to
+     enter into firmware update, ending as soon as the host answers */
   if(!doUpdate && !bootDelay) {
     /* Enable the mailbox. */
     SetupLabXMailbox();
 
     puts("Checking for firmware update request from host... ");
-    for(i = 0; i < 4; ++i) {
+    checkStart = get_timer(0);
+    while(get_timer(checkStart) < CONFIG_FWUPDATE_CHECK_MS) {
       if(ReadLabXMailbox(request, &reqSize, FALSE)) {
         puts("requested\n");
 #ifdef _LABXDEBUG
@@ -397,12 +1168,13 @@ int CheckFirmwareUpdate(void)
         reqSize = sizeof(RequestMessageBuffer_t);
 
         /* Break out of loop, we received a valid request */
-        if(getStatusCode_resp(response) == e_EC_SUCCESS) break;
-      } else {
-        udelay(250000);
+        if(getStatusCode_resp(response) == e_EC_SUCCESS) {
+          gotRequest = 1;
+          break;
+        }
       }
     }
-    if(i == 4) {
+    if(!gotRequest) {
       puts("none requested\n");
     }
   }
@@ -423,6 +1195,9 @@ int CheckFirmwareUpdate(void)
     while(1);
   }
 
+  /* Stop servicing the mailbox; its messages now belong to the OS */
+  ShutdownLabXMailbox();
+
   /* Return, supplying a nonzero value if a boot delay was requested.
    * If a firmware update was requested, we will never get here. */
   return(returnValue);
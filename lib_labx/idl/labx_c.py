@@ -71,6 +71,25 @@ class CxxTypeVisitor (idlvisitor.AstVisitor):
     def isResultBasetype(self):
         return self.basetype
 
+# Marshalled size, in bytes, of the types whose size does not depend upon their
+# value; members of these types can be placed at offsets fixed at generation time
+fixedSizeMap = {
+    idltype.tk_octet:   1,
+    idltype.tk_char:    1,
+    idltype.tk_short:   2,
+    idltype.tk_ushort:  2,
+    idltype.tk_long:    4,
+    idltype.tk_ulong:   4,
+    idltype.tk_boolean: 4,
+    idltype.tk_enum:    4
+    }
+
+def fixedSize(type):
+    return fixedSizeMap.get(type.unalias().kind())
+
+# In-line message accessor used for each fixed size
+fixedAccessorMap = { 1: "UINT8", 2: "UINT16", 4: "UINT32" }
+
 # output a pure virtual class member prototype for a service operation
 class CxxInterfaceVisitor (CxxTypeVisitor):
 
@@ -277,12 +296,16 @@ class CxxStubMethodImplVisitor (CxxInterfaceVisitor):
     def getOperationName(self, node):
         return self.cn + "_stub_" + CxxInterfaceVisitor.getOperationName(self, node)
 
+    # Without a body function, output the prototype only
     def getOperationTerminator(self, node):
+        if self.func is None:
+            return ";"
         return ""
 
     def visitOperation(self, node):
         CxxInterfaceVisitor.visitOperation(self, node)
-        self.func(self.st, node, eNone, self.getReturnType())
+        if self.func is not None:
+            self.func(self.st, node, eNone, self.getReturnType())
 
 # Output an implementation for a stub attribute operation get/set
 class CxxAttributesStubMethodImplVisitor (CxxAttributesInterfaceVisitor):
@@ -299,16 +322,21 @@ class CxxAttributesStubMethodImplVisitor (CxxAttributesInterfaceVisitor):
     def getOperationName(self, node):
         return self.cn + "_stub_" + CxxAttributesInterfaceVisitor.getOperationName(self, node)
 
+    # Without a body function, output the prototype only
     def getOperationTerminator(self, node):
+        if self.func is None:
+            return ";"
         return ""
 
     def visitGetOperation(self, node):
         CxxAttributesInterfaceVisitor.visitGetOperation(self, node)
-        self.func(self.st, node, eGetter, self.getReturnType())
+        if self.func is not None:
+            self.func(self.st, node, eGetter, self.getReturnType())
 
     def visitSetOperation(self, node):
         CxxAttributesInterfaceVisitor.visitSetOperation(self, node)
-        self.func(self.st, node, eSetter, self.getReturnType())
+        if self.func is not None:
+            self.func(self.st, node, eSetter, self.getReturnType())
 
 class CxxAttributesUnmarshalVisitor (CxxAttributesStaticVisitor):
 
@@ -377,6 +405,8 @@ class CxxStubHeaderVisitor (idlvisitor.AstVisitor):
         self.st.out("uint16_t instanceNum;")
         self.st.dec_indent()
         self.st.out("};\n")
+        CxxStubImplVisitor(self.st, None).visitInterface(node)
+        self.st.out("")
 
 # output a class implementation for a stub
 class CxxStubImplVisitor (idlvisitor.AstVisitor):
@@ -588,6 +618,13 @@ class CxxTypeDeclVisitor (CxxTypeVisitor):
             typename = idlutil.ccolonName(d.scopedName())
             self.st.out("typedef @type@ @id@@arr@;\n", type=type, id=string.replace(typename, ":", "_"), arr=arr);
 
+    def visitConst(self, node):
+        if node.constKind() in [idltype.tk_octet, idltype.tk_ushort, idltype.tk_ulong, idltype.tk_ulonglong]:
+            value = "0x%08X" % node.value()
+        else:
+            value = str(node.value())
+        self.st.out("#define @id@ @value@\n", id=node.identifier(), value=value)
+
 class CxxInterfaceUnmarshalStaticForwardVisitor (idlvisitor.AstVisitor):
 
     def __init__(self, st):
@@ -758,9 +795,12 @@ class CxxTreeVisitor (idlvisitor.AstVisitor):
         st.out("#include \"@ns@_type.h\"\n", ns = node.identifier())
         st.inc_indent()
         st.out("")
+        # Signature shared by every entry of the dispatch tables
+        st.out("typedef AvbDefs__ErrorCode (*MessageHandler_t)(RequestMessageBuffer_t request, ResponseMessageBuffer_t response);\n")
         # Forward declarations
         st.out("static AvbDefs__ErrorCode get_unmarshal(RequestMessageBuffer_t request, ResponseMessageBuffer_t response);");
         st.out("static AvbDefs__ErrorCode set_unmarshal(RequestMessageBuffer_t request, ResponseMessageBuffer_t response);");
+        st.out("static AvbDefs__ErrorCode service_unmarshal(RequestMessageBuffer_t request, ResponseMessageBuffer_t response);");
         visitor = CxxInterfaceUnmarshalStaticForwardVisitor(st)
         for n in node.definitions():
             n.accept(visitor)
@@ -786,6 +826,9 @@ class CxxTreeVisitor (idlvisitor.AstVisitor):
         st.out("#include <linux/types.h>\n");
         st.out("#include \"@ns@.h\"\n", ns = node.identifier())
         st.inc_indent()
+        # Transport supplied by the client; sends the request and fills in
+        # the response
+        st.out("extern void SendMessage(RequestMessageBuffer_t request, ResponseMessageBuffer_t response);\n")
         for n in node.definitions():
             n.accept(visitor)
         st.dec_indent()
@@ -849,59 +892,68 @@ class CxxTreeVisitor (idlvisitor.AstVisitor):
         st.out("break;\n")
         st.dec_indent()
 
-    def outputGetUnmarshal(self, st, node):
-        st.out("AvbDefs__ErrorCode get_unmarshal(RequestMessageBuffer_t request, ResponseMessageBuffer_t response)")
-        st.out("{")
-        st.inc_indent()
-        st.out("switch(getAttributeCode_req(request))")
+    def outputServiceTableEntry(self, st, code, fname):
+        st.out("[@code@ - MIN_SERVICE_CODE] = @fname@,", code=code, fname=fname)
+
+    def outputAttributeTableEntry(self, st, code, fname):
+        st.out("[@code@ - MIN_ATTRIBUTE_CODE] = @fname@,", code=code, fname=fname)
+
+    # Output a table of unmarshal functions indexed directly by service or
+    # attribute code, less the first code of its range
+    def outputDispatchTable(self, st, node, name, visitorClass, func):
+        st.out("static const MessageHandler_t @name@[] =", name=name)
         st.out("{")
         st.inc_indent()
-        visitor = CxxInterfaceGetUnmarshalBodyVisitor(st, self.outputCaseEntry)
+        visitor = visitorClass(st, func)
         for n in node.definitions():
             n.accept(visitor)
-        st.out("default:")
-        st.inc_indent()
-        st.out("return e_EC_INVALID_ATTRIBUTE_CODE;");
         st.dec_indent()
-        st.dec_indent()
-        st.out("}")
-        st.dec_indent()
-        st.out("}\n")
+        st.out("};\n")
 
-    def outputSetUnmarshal(self, st, node):
-        st.out("AvbDefs__ErrorCode set_unmarshal(RequestMessageBuffer_t request, ResponseMessageBuffer_t response)")
+    # Output a dispatch function looking up the code at "field" in "table"
+    def outputDispatch(self, st, fname, field, minCode, table, error):
+        st.out("AvbDefs__ErrorCode @fname@(RequestMessageBuffer_t request, ResponseMessageBuffer_t response)", fname=fname)
         st.out("{")
         st.inc_indent()
-        st.out("switch(getAttributeCode_req(request))")
-        st.out("{")
+        st.out("uint32_t idx = ((uint32_t) MSG_GET_UINT16(request, @field@) - @minCode@);", field=field, minCode=minCode)
+        st.out("if ((idx < (sizeof(@table@) / sizeof(@table@[0]))) && (@table@[idx] != NULL))", table=table)
         st.inc_indent()
-        visitor = CxxInterfaceSetUnmarshalBodyVisitor(st, self.outputCaseEntry)
-        for n in node.definitions():
-            n.accept(visitor)
-        st.out("default:")
-        st.inc_indent()
-        st.out("return e_EC_INVALID_ATTRIBUTE_CODE;");
-        st.dec_indent()
+        st.out("return @table@[idx](request, response);", table=table)
         st.dec_indent()
-        st.out("}")
+        st.out("MSG_SET_UINT16(response, RESP_STATUS_OFFSET, @error@);", error=error)
+        st.out("MSG_SET_UINT16(response, RESP_LENGTH_OFFSET, RESP_PAYLOAD_OFFSET);")
+        st.out("return @error@;", error=error)
         st.dec_indent()
         st.out("}\n")
 
+    def outputGetUnmarshal(self, st, node):
+        self.outputDispatchTable(st, node, "getTable", CxxInterfaceGetUnmarshalBodyVisitor,
+                                 self.outputAttributeTableEntry)
+        self.outputDispatch(st, "get_unmarshal", "REQ_ATTRIBUTE_CODE_OFFSET", "MIN_ATTRIBUTE_CODE",
+                            "getTable", "e_EC_INVALID_ATTRIBUTE_CODE")
+
+    def outputSetUnmarshal(self, st, node):
+        self.outputDispatchTable(st, node, "setTable", CxxInterfaceSetUnmarshalBodyVisitor,
+                                 self.outputAttributeTableEntry)
+        self.outputDispatch(st, "set_unmarshal", "REQ_ATTRIBUTE_CODE_OFFSET", "MIN_ATTRIBUTE_CODE",
+                            "setTable", "e_EC_INVALID_ATTRIBUTE_CODE")
+
     def outputUnmarshal(self, st, node):
+        self.outputDispatchTable(st, node, "serviceTable", CxxInterfaceUnmarshalBodyVisitor,
+                                 self.outputServiceTableEntry)
+        self.outputDispatch(st, "service_unmarshal", "REQ_SERVICE_CODE_OFFSET", "MIN_SERVICE_CODE",
+                            "serviceTable", "e_EC_INVALID_SERVICE_CODE")
         st.out("AvbDefs__ErrorCode @n@__unmarshal(RequestMessageBuffer_t request, ResponseMessageBuffer_t response)", n=node.identifier()) # unmarshal
         st.out("{")
         st.inc_indent()
-        st.out("switch(getServiceCode_req(request))")
+        st.out("switch(MSG_GET_UINT16(request, REQ_SERVICE_CODE_OFFSET))")
         st.out("{")
         st.inc_indent()
         self.outputCaseEntry(st, "k_SC_getAttribute", "get_unmarshal") 
         self.outputCaseEntry(st, "k_SC_setAttribute", "set_unmarshal") 
-        visitor = CxxInterfaceUnmarshalBodyVisitor(st, self.outputCaseEntry)
-        for n in node.definitions():
-            n.accept(visitor)
         st.out("default:")
         st.inc_indent()
-        st.out("return e_EC_INVALID_SERVICE_CODE;");
+        st.out("return service_unmarshal(request, response);");
         st.dec_indent()
         st.dec_indent()
         st.out("}")
@@ -917,10 +969,14 @@ class CxxTreeVisitor (idlvisitor.AstVisitor):
         if (setter == eSetter) or (setter == eGetter):
             obj = "Attributes"
             
-        # Unmarshal input parameter data
-        st.out("uint32_t offset = getPayloadOffset_req(request);")
+        # Unmarshal input parameter data.  Parameters are read from offsets
+        # fixed at generation time until the first one of variable size, and
+        # from a running offset after that.
+        self.fixedOffset = ("REQ_PAYLOAD_OFFSET", 0)
+        self.offsetDeclared = False
+        inParams = [p for p in node.parameters() if p.is_in()]
         for p in node.parameters():
-            self.outputParameterUnmarshal(st, p, "request")
+            self.outputParameterUnmarshal(st, p, "request", (len(inParams) > 0) and (p == inParams[-1]))
         # Make the function call
         rtvisitor = CxxTypeVisitor()
         node.returnType().accept(rtvisitor)
@@ -933,7 +989,7 @@ class CxxTreeVisitor (idlvisitor.AstVisitor):
         paraml = []
         for p in node.parameters():
             ref = ""
-            if (setter == eGetter) and (p.is_out()):
+            if (setter != eSetter) and (p.is_out()):
                 ref = "&"
             paramVisitor = CxxTypeVisitor()
             p.paramType().accept(paramVisitor)
@@ -944,21 +1000,63 @@ class CxxTreeVisitor (idlvisitor.AstVisitor):
         st.out("@rt@ retval = @fname@(@params@);",
             rt=rtvisitor.getResultType(), fname=fname, params=string.join(paraml, ", "))
 
-        # Marshal the output parameter data
-        st.out("offset = getPayloadOffset_resp(response);")
+        # Marshal the output parameter data, likewise at fixed offsets
+        # for as long as possible
+        self.fixedOffset = ("RESP_PAYLOAD_OFFSET", 0)
         for p in node.parameters():
             self.outputParameterMarshal(st, p, setter, "response")
-        st.out("setLength_resp(response,offset);")
+        if self.fixedOffset is None:
+            st.out("MSG_SET_UINT16(response, RESP_LENGTH_OFFSET, offset);")
+        else:
+            st.out("MSG_SET_UINT16(response, RESP_LENGTH_OFFSET, @off@);", off=self.offsetString(self.fixedOffset))
+        st.out("MSG_SET_UINT16(response, RESP_STATUS_OFFSET, retval);")
         st.out("return retval;")
         st.dec_indent()
         st.out("}\n")
 
-    def outputParameterUnmarshal(self, st, p, bn):
+    # Render a fixed offset, held as a (base, displacement) pair
+    def offsetString(self, off):
+        if off[1] == 0:
+            return off[0]
+        return off[0] + " + " + str(off[1])
+
+    # Advance the fixed offset past a value of the given size, or switch over
+    # to a running offset if the size is not fixed.  Returns the offset of the
+    # value if it was fixed, None otherwise.
+    def advanceOffset(self, st, size):
+        off = self.fixedOffset
+        if off is None:
+            return None
+        if size is None:
+            prefix = ""
+            if not self.offsetDeclared:
+                prefix = "uint32_t "
+            st.out("@prefix@offset = @off@;", prefix=prefix, off=self.offsetString(off))
+            self.offsetDeclared = True
+            self.fixedOffset = None
+            return None
+        self.fixedOffset = (off[0], off[1] + size)
+        return self.offsetString(off)
+
+    def outputParameterUnmarshal(self, st, p, bn, last):
         ptvisitor = CxxTypeVisitor()
         p.paramType().accept(ptvisitor)
-        st.out("@pt@ @pn@;", pt=ptvisitor.getResultType(), pn=p.identifier())
-        if p.is_in():
-            st.out("offset += @pt@_unmarshal(@bn@, offset, &@pn@);", pt=ptvisitor.getResultType(), pn=p.identifier(), bn=bn)
+        pt = ptvisitor.getResultType()
+        if not p.is_in():
+            st.out("@pt@ @pn@;", pt=pt, pn=p.identifier())
+            return
+        size = fixedSize(p.paramType())
+        off = self.advanceOffset(st, size)
+        if off is not None:
+            st.out("@pt@ @pn@ = (@pt@) MSG_GET_@acc@(@bn@, @off@);", pt=pt, pn=p.identifier(),
+                   acc=fixedAccessorMap[size], bn=bn, off=off)
+        else:
+            # The running offset is not needed past the last input parameter
+            advance = "offset +="
+            if last:
+                advance = "(void)"
+            st.out("@pt@ @pn@;", pt=pt, pn=p.identifier())
+            st.out("@advance@ @pt@_unmarshal(@bn@, offset, &@pn@);", advance=advance, pt=pt, pn=p.identifier(), bn=bn)
 
     def outputParameterMarshal(self, st, p, setter, bn):
         # inout params are for just input on the setter
@@ -967,7 +1065,14 @@ class CxxTreeVisitor (idlvisitor.AstVisitor):
         if p.is_in() and (setter == eSetter):
             return
         if p.is_out():
-            st.out("offset += @pt@_marshal(@bn@, offset, &@pn@);", pt=ptvisitor.getResultType(), pn=p.identifier(), bn=bn)
+            size = fixedSize(p.paramType())
+            off = self.advanceOffset(st, size)
+            if off is None:
+                st.out("offset += @pt@_marshal(@bn@, offset, &@pn@);", pt=ptvisitor.getResultType(), pn=p.identifier(), bn=bn)
+            elif p.paramType().unalias().kind() == idltype.tk_boolean:
+                st.out("MSG_SET_UINT32(@bn@, @off@, (@pn@ ? 0xFFFFFFFF : 0x00000000));", pn=p.identifier(), bn=bn, off=off)
+            else:
+                st.out("MSG_SET_@acc@(@bn@, @off@, @pn@);", acc=fixedAccessorMap[size], pn=p.identifier(), bn=bn, off=off)
 
     def outputStubBody(self, st, node, setter, returnType):
         st.out("{")
@@ -1007,25 +1112,28 @@ class CxxTreeVisitor (idlvisitor.AstVisitor):
         st.dec_indent()
         st.out("}\n")
 
+    # The marshalling functions all take a pointer to the value; return the
+    # stub's parameter as one, given how getParameterString() declared it
+    def stubParameterRef(self, p, setter, ptvisitor):
+        if (not ptvisitor.isResultBasetype()) or ((setter != eSetter) and p.is_out()):
+            return p.identifier()
+        return "&" + p.identifier()
+
     def outputParameterStubMarshal(self, st, p, setter, bn):
         ptvisitor = CxxTypeVisitor()
         p.paramType().accept(ptvisitor)
-        deref = ""
-        if p.is_out() and (((1 != ptvisitor.isResultBasetype()) and (setter != eSetter)) or (setter == eGetter)):
-            deref = "*"
         if p.is_in():
-            st.out("offset += @pt@_marshal(@bn@, offset, @deref@@pn@);", pt=ptvisitor.getResultType(), pn=p.identifier(), bn=bn, deref=deref)
+            st.out("offset += @pt@_marshal(@bn@, offset, @ref@);", pt=ptvisitor.getResultType(),
+                   ref=self.stubParameterRef(p, setter, ptvisitor), bn=bn)
 
     def outputParameterStubUnmarshal(self, st, p, setter, bn):
         ptvisitor = CxxTypeVisitor()
         p.paramType().accept(ptvisitor)
-        deref = ""
-        if (setter == eGetter):
-            deref = "*"
         if p.is_in() and (setter == eSetter):
             return
         if p.is_out():
-            st.out("offset += @pt@_unmarshal(@bn@, offset, @deref@@pn@);", pt=ptvisitor.getResultType(), pn=p.identifier(), bn=bn, deref=deref)
+            st.out("offset += @pt@_unmarshal(@bn@, offset, @ref@);", pt=ptvisitor.getResultType(),
+                   ref=self.stubParameterRef(p, setter, ptvisitor), bn=bn)
 
 def run(tree, args):
     visitor = CxxTreeVisitor()
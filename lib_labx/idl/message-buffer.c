@@ -57,10 +57,20 @@ uint16_t sequence_t_uint8_t_marshal(RequestMessageBuffer_t request, uint32_t off
   return sequenceOffset;
 }
 
+uint16_t string_t_marshal(RequestMessageBuffer_t request, uint32_t offset, string_t *str)
+{
+  /* The size includes the NULL terminator */
+  uint32_t size = strlen(*str) + 1;
+
+  uint32_t_marshal(request, offset, &size);
+  memcpy(&request[offset + 4], *str, size);
+  return(4+size);
+}
+
 uint16_t string_t_unmarshal(RequestMessageBuffer_t request, uint32_t offset, string_t *str)
 {
   uint32_t size;
-  memcpy(&size, &request[offset], 4);
+  uint32_t_unmarshal(request, offset, &size);
   *str = (string_t) malloc(size);
   memset(*str, 'S', size);
   memcpy(*str, &request[offset + 4], size);
@@ -2,6 +2,7 @@
 #define __MESSAGE_BUFFER_H__
 
 #include <linux/types.h>
+#include <linux/stddef.h>
 
 #define MAX_MSG_BUF_SIZE 1024
 
@@ -19,6 +20,37 @@ typedef struct
   uint8_t m_data[MAX_MSG_BUF_SIZE];
 } sequence_t_uint8_t;
 
+// Fixed layout of the request and response headers
+#define REQ_LENGTH_OFFSET          (0)
+#define REQ_CLASS_CODE_OFFSET      (4)
+#define REQ_INSTANCE_NUMBER_OFFSET (6)
+#define REQ_SERVICE_CODE_OFFSET    (8)
+#define REQ_ATTRIBUTE_CODE_OFFSET  (10)
+#define REQ_PAYLOAD_OFFSET         (12)
+
+#define RESP_LENGTH_OFFSET         (0)
+#define RESP_STATUS_OFFSET         (2)
+#define RESP_PAYLOAD_OFFSET        (4)
+
+// In-line big-endian field accessors, used by generated code to read and
+// write fields whose offsets are known at generation time
+#define MSG_GET_UINT8(msg, off)  ((uint8_t) (msg)[(off)])
+#define MSG_GET_UINT16(msg, off) ((uint16_t) (((msg)[(off)] << 8) | (msg)[(off) + 1]))
+#define MSG_GET_UINT32(msg, off) ((((uint32_t) MSG_GET_UINT16(msg, (off))) << 16) | \
+                                  MSG_GET_UINT16(msg, (off) + 2))
+
+#define MSG_SET_UINT8(msg, off, value) ((msg)[(off)] = (uint8_t) (value))
+#define MSG_SET_UINT16(msg, off, value) do { \
+    uint16_t _v = (value);                   \
+    (msg)[(off)] = (uint8_t) (_v >> 8);      \
+    (msg)[(off) + 1] = (uint8_t) _v;         \
+  } while (0)
+#define MSG_SET_UINT32(msg, off, value) do { \
+    uint32_t _v32 = (value);                 \
+    MSG_SET_UINT16(msg, (off), _v32 >> 16);  \
+    MSG_SET_UINT16(msg, (off) + 2, _v32);    \
+  } while (0)
+
 // Common constants
 
 // First class-specific service or attribute codes to be used for
@@ -45,10 +77,16 @@ typedef enum {
   k_SC_sendDataPacket      = (MIN_SERVICE_CODE + 10),
   k_SC_remainInBootloader  = (MIN_SERVICE_CODE + 11),
   k_SC_requestBootDelay    = (MIN_SERVICE_CODE + 12),
+  k_SC_startStreamingUpdate = (MIN_SERVICE_CODE + 13),
+  k_SC_startDeltaUpdate    = (MIN_SERVICE_CODE + 14),
+  k_SC_sendWindowedDataPacket = (MIN_SERVICE_CODE + 15),
 } FirmwareUpdateServiceCode;
 
 typedef enum {
   k_AC_ExecutingImageType = (MIN_ATTRIBUTE_CODE    ),
+  k_AC_streamingUpdateProgress = (MIN_ATTRIBUTE_CODE + 1),
+  k_AC_runningImageCrc = (MIN_ATTRIBUTE_CODE + 6),
+  k_AC_dataTransferWindow = (MIN_ATTRIBUTE_CODE + 7),
 } FirmwareUpdateAttributeCode;
 
 typedef enum {
@@ -80,6 +118,7 @@ extern uint16_t getPayloadOffset_resp(ResponseMessageBuffer_t msg);
 
 extern uint16_t sequence_t_uint8_t_marshal(ResponseMessageBuffer_t request, uint32_t offset, sequence_t_uint8_t *data);
 extern uint16_t sequence_t_uint8_t_unmarshal(ResponseMessageBuffer_t request, uint32_t offset, sequence_t_uint8_t *data);
+extern uint16_t string_t_marshal(ResponseMessageBuffer_t request, uint32_t offset, string_t *str);
 extern uint16_t string_t_unmarshal(ResponseMessageBuffer_t request, uint32_t offset, string_t *str);
 
 /* Marshalling utility methods */
@@ -3,6 +3,12 @@
 #ifdef CONFIG_FIRMWARE_UPDATE
 
 #include "labx-mailbox.h"
+#include <common.h>
+#include <asm/byteorder.h>
+#ifdef CONFIG_LABX_MAILBOX_IRQ
+#include <asm/microblaze_intc.h>
+#include "idl/message-buffer.h"
+#endif
 
 #ifndef FALSE
 #define FALSE 0
@@ -14,34 +20,185 @@
 uint8_t bPollingLabXMbox = FALSE;
 uint8_t bWaitingForMsg = FALSE;
 
+/* Message RAM holds each message in network byte order, packed most
+ * significant byte first into successive words.  On a big-endian processor
+ * these conversions vanish and the copies below are plain word moves.
+ */
+#define MBOX_WORD_TO_BYTES(word) cpu_to_be32(word)
+#define BYTES_TO_MBOX_WORD(word) be32_to_cpu(word)
+
+#if defined(CONFIG_LABX_MAILBOX_ZERO_COPY) && !defined(__BIG_ENDIAN)
+#error CONFIG_LABX_MAILBOX_ZERO_COPY requires a big-endian processor
+#endif
+
+/**
+ * Copies the message currently in message RAM into a buffer, moving whole
+ * words and then any trailing bytes, without writing past the end of the
+ * message.
+ *
+ * buffer - Buffer to copy the message into
+ * size   - Length of the message
+ */
+static void CopyFromLabXMailbox(uint8_t *buffer, uint32_t size)
+{
+  volatile uint32_t *msgRam = (volatile uint32_t *) LABX_MBOX_DATA;
+  uint32_t words = (size / 4);
+  uint32_t word;
+  uint32_t idx;
+
+  if(((ulong) buffer & 3) == 0) {
+    for (idx = 0; idx < words; idx++) {
+      ((uint32_t *) buffer)[idx] = MBOX_WORD_TO_BYTES(msgRam[idx]);
+    }
+  } else {
+    for (idx = 0; idx < words; idx++) {
+      word = MBOX_WORD_TO_BYTES(msgRam[idx]);
+      memcpy(&buffer[idx * 4], &word, 4);
+    }
+  }
+  if(size & 3) {
+    word = MBOX_WORD_TO_BYTES(msgRam[words]);
+    memcpy(&buffer[words * 4], &word, (size & 3));
+  }
+}
+
+#ifdef CONFIG_LABX_MAILBOX_IRQ
+/* Number of received messages which may be queued awaiting service */
+#ifndef CONFIG_LABX_MAILBOX_RX_QUEUE
+#define CONFIG_LABX_MAILBOX_RX_QUEUE 4
+#endif
+
+/* Receive queue filled from the mailbox interrupt.  The interrupt handler
+ * alone advances rxHead and the reader alone advances rxTail, so neither
+ * needs to disable interrupts.
+ */
+typedef struct {
+  uint32_t length;
+  uint32_t data[MAX_MSG_BUF_SIZE / 4];
+} LabXMailboxMsg_t;
+
+static LabXMailboxMsg_t rxQueue[CONFIG_LABX_MAILBOX_RX_QUEUE];
+static volatile uint32_t rxHead;
+static volatile uint32_t rxTail;
+static uint8_t bIrqDriven = FALSE;
+#ifdef CONFIG_LABX_MAILBOX_ZERO_COPY
+static uint8_t bPeeked = FALSE;
+#endif
+
+/**
+ * Mailbox interrupt handler; moves each message from message RAM into the
+ * receive queue as soon as it arrives, freeing the mailbox for the host.
+ */
+static void LabXMailboxIsr(void *arg)
+{
+  uint32_t flags_reg = LABX_MBOX_READ_REG(SUPRV_IRQ_FLAGS_REG);
+  uint32_t nextHead = ((rxHead + 1) % CONFIG_LABX_MAILBOX_RX_QUEUE);
+  uint32_t bufLen;
+
+  if((flags_reg & SUPRV_IRQ_0) && (nextHead == rxTail)) {
+    /* The queue is full; leave the message pending in message RAM and mask
+     * the interrupt until the reader frees a slot.
+     */
+    LABX_MBOX_WRITE_REG(SUPRV_IRQ_MASK_REG, NO_IRQS);
+    return;
+  }
+
+  LABX_MBOX_WRITE_REG(SUPRV_IRQ_FLAGS_REG, flags_reg);
+  if(!(flags_reg & SUPRV_IRQ_0)) return;
+
+  /* Messages too long for a queue slot are dropped, as when polling */
+  bufLen = LABX_MBOX_READ_REG(SUPRV_MSG_LEN_REG);
+  if(bufLen > sizeof(rxQueue[0].data)) return;
+
+  rxQueue[rxHead].length = bufLen;
+  CopyFromLabXMailbox((uint8_t *) rxQueue[rxHead].data, bufLen);
+  rxHead = nextHead;
+}
+
+/**
+ * Waits for the receive queue to hold a message, honoring bWaitingForMsg
+ * exactly as the polled path does.
+ *
+ * Returns:
+ *       The oldest queued message, or NULL if none arrived
+ */
+static LabXMailboxMsg_t *WaitLabXQueue(uint8_t pollForMsg)
+{
+  bWaitingForMsg = TRUE;
+  while(bWaitingForMsg && (rxTail == rxHead)) {
+    if(!pollForMsg) bWaitingForMsg = FALSE;
+  }
+  bWaitingForMsg = FALSE;
+  return((rxTail == rxHead) ? NULL : &rxQueue[rxTail]);
+}
+
+/**
+ * Releases the oldest queued message, resuming reception if the interrupt
+ * handler had stalled on a full queue.
+ */
+static void ReleaseLabXQueue(void)
+{
+  rxTail = ((rxTail + 1) % CONFIG_LABX_MAILBOX_RX_QUEUE);
+  LABX_MBOX_WRITE_REG(SUPRV_IRQ_MASK_REG, SUPRV_IRQ_0);
+}
+#endif /* CONFIG_LABX_MAILBOX_IRQ */
+
 void SetupLabXMailbox(void)
 {
   /* Clear the message ready flag and reset / enable the mailbox */
   LABX_MBOX_WRITE_REG(SUPRV_CONTROL_REG, LABX_MBOX_DISABLE);
   LABX_MBOX_WRITE_REG(SUPRV_IRQ_MASK_REG, NO_IRQS);
+#ifdef CONFIG_LABX_MAILBOX_IRQ
+  /* Hand received messages to the interrupt handler from now on */
+  rxHead = 0;
+  rxTail = 0;
+#ifdef CONFIG_LABX_MAILBOX_ZERO_COPY
+  bPeeked = FALSE;
+#endif
+  install_interrupt_handler(CONFIG_LABX_MAILBOX_IRQ, LabXMailboxIsr, NULL);
+  bIrqDriven = TRUE;
+  LABX_MBOX_WRITE_REG(SUPRV_IRQ_FLAGS_REG, ALL_IRQS);
+  LABX_MBOX_WRITE_REG(SUPRV_CONTROL_REG, LABX_MBOX_ENABLE);
+  LABX_MBOX_WRITE_REG(SUPRV_IRQ_MASK_REG, SUPRV_IRQ_0);
+#else
   LABX_MBOX_WRITE_REG(SUPRV_CONTROL_REG, LABX_MBOX_ENABLE);
+#endif
 }
 
 /**
- * Reads a message out of the LabX Mailbox. Controlled by
- * global variable bPollingLabXMbox which can be used to
- * force return
+ * Returns the mailbox to polled operation once U-Boot has finished with it,
+ * masking the mailbox interrupt and releasing its handler so that later
+ * host messages are left in message RAM for the operating system's driver.
+ */
+void ShutdownLabXMailbox(void)
+{
+#ifdef CONFIG_LABX_MAILBOX_IRQ
+  if(!bIrqDriven) return;
+
+  LABX_MBOX_WRITE_REG(SUPRV_IRQ_MASK_REG, NO_IRQS);
+  install_interrupt_handler(CONFIG_LABX_MAILBOX_IRQ, NULL, NULL);
+  bIrqDriven = FALSE;
+#endif
+}
+
+/**
+ * Waits for a message to arrive in the LabX Mailbox, without copying it out.
+ * Controlled by global variable bPollingLabXMbox which can be used to force
+ * return.
  *
  * Paramaters:
- *       buffer     - Buffer to read data into
- *       size       - [IN]  - Size of input buffer
- *                  - [OUT] - Number of bytes read
- *       pollForMsg - [IN]  - Flag indicating if a continuous 
+ *       maxSize    - [IN]  - Largest message the caller can accept
+ *       size       - [OUT] - Length of the message received
+ *       pollForMsg - [IN]  - Flag indicating if a continuous
  *                            loop is used to wait for a msg
  *
  * Returns:
- *       TRUE  - Message was read
- *       FALSE - No message was read
+ *       TRUE  - A message is waiting in message RAM
+ *       FALSE - No message was received
  */
-int ReadLabXMailbox(uint8_t *buffer, uint32_t *size, uint8_t pollForMsg)
+static int WaitLabXMailbox(uint32_t maxSize, uint32_t *size, uint8_t pollForMsg)
 {
   int bStatus = FALSE;
-  int idx;
 
   bWaitingForMsg = TRUE;
   while(bWaitingForMsg)
@@ -56,7 +213,7 @@ int ReadLabXMailbox(uint8_t *buffer, uint32_t *size, uint8_t pollForMsg)
     {
       /* A message has been received from the host, obtain its length */
       uint32_t bufLen = LABX_MBOX_READ_REG(SUPRV_MSG_LEN_REG);
-      if (*size < bufLen) {
+      if (maxSize < bufLen) {
         /* We received a message longer than the requested message size; bail
          * out and return FALSE as an indication
          */
@@ -66,11 +223,6 @@ int ReadLabXMailbox(uint8_t *buffer, uint32_t *size, uint8_t pollForMsg)
       /* Received a message, inform the caller of its length */
       *size = bufLen;
 
-      /* Retrieve and buffer the message words for the client */
-      for (idx = 0; idx < ((*size + 3) / 4); idx++) {
-        ((uint32_t *) buffer)[idx] = ((uint32_t *) LABX_MBOX_DATA)[idx];
-      }
-
       bStatus = TRUE;
       bWaitingForMsg = FALSE;
     }
@@ -84,6 +236,94 @@ int ReadLabXMailbox(uint8_t *buffer, uint32_t *size, uint8_t pollForMsg)
   return bStatus;
 }
 
+/**
+ * Reads a message out of the LabX Mailbox. Controlled by
+ * global variable bPollingLabXMbox which can be used to
+ * force return
+ *
+ * Paramaters:
+ *       buffer     - Buffer to read data into
+ *       size       - [IN]  - Size of input buffer
+ *                  - [OUT] - Number of bytes read
+ *       pollForMsg - [IN]  - Flag indicating if a continuous 
+ *                            loop is used to wait for a msg
+ *
+ * Returns:
+ *       TRUE  - Message was read
+ *       FALSE - No message was read
+ */
+int ReadLabXMailbox(uint8_t *buffer, uint32_t *size, uint8_t pollForMsg)
+{
+#ifdef CONFIG_LABX_MAILBOX_IRQ
+  if(bIrqDriven) {
+    LabXMailboxMsg_t *msg = WaitLabXQueue(pollForMsg);
+    int bStatus = FALSE;
+
+    if(msg == NULL) return FALSE;
+
+    /* As when polling, a message longer than the buffer is discarded */
+    if(msg->length <= *size) {
+      *size = msg->length;
+      memcpy(buffer, msg->data, msg->length);
+      bStatus = TRUE;
+    }
+    ReleaseLabXQueue();
+    return bStatus;
+  }
+#endif
+
+  if(!WaitLabXMailbox(*size, size, pollForMsg)) return FALSE;
+
+  /* Retrieve and buffer the message for the client */
+  CopyFromLabXMailbox(buffer, *size);
+  return TRUE;
+}
+
+#ifdef CONFIG_LABX_MAILBOX_ZERO_COPY
+/**
+ * Waits for a message exactly as ReadLabXMailbox() does, but rather than
+ * copying the message out, returns its location in message RAM so that it
+ * can be unmarshalled in place.  Message RAM is shared with outgoing
+ * messages, so the request is only valid until WriteLabXMailbox() is called.
+ * When the mailbox is interrupt-driven the message is instead left in the
+ * receive queue, where it remains valid until the next call.
+ *
+ * Paramaters:
+ *       size       - [IN]  - Largest message the caller can accept
+ *                  - [OUT] - Length of the message received
+ *       pollForMsg - [IN]  - Flag indicating if a continuous
+ *                            loop is used to wait for a msg
+ *
+ * Returns:
+ *       The message, or NULL if no message was received
+ */
+uint8_t *PeekLabXMailbox(uint32_t *size, uint8_t pollForMsg)
+{
+#ifdef CONFIG_LABX_MAILBOX_IRQ
+  if(bIrqDriven) {
+    LabXMailboxMsg_t *msg;
+
+    /* Release the message handed out by the previous call */
+    if(bPeeked) ReleaseLabXQueue();
+    bPeeked = FALSE;
+
+    while((msg = WaitLabXQueue(pollForMsg)) != NULL) {
+      if(msg->length <= *size) {
+        *size = msg->length;
+        bPeeked = TRUE;
+        return (uint8_t *) msg->data;
+      }
+      ReleaseLabXQueue();
+    }
+    return NULL;
+  }
+#endif
+
+  if(!WaitLabXMailbox(*size, size, pollForMsg)) return NULL;
+  return (uint8_t *) LABX_MBOX_DATA;
+}
+#endif /* CONFIG_LABX_MAILBOX_ZERO_COPY */
+
 /**
  * Writes a message out to the LabX mailbox
  *
@@ -92,15 +332,26 @@ int ReadLabXMailbox(uint8_t *buffer, uint32_t *size, uint8_t pollForMsg)
  */
 void WriteLabXMailbox(uint8_t *buffer, uint32_t size)
 {
-  int widx = 0; 
-  int bidx = 0;
-  uint32_t requestWord;
-
-  /* Write the response words into the data buffer */
-  for(widx = 0; widx < (size + 3) / 4; widx++) {
-    requestWord = buffer[bidx+3] | (buffer[bidx+2]<<8) | (buffer[bidx+1]<<16) | (buffer[bidx]<<24); 
-    ((uint32_t *) LABX_MBOX_DATA)[widx] = requestWord;
-    bidx+=4;
+  volatile uint32_t *msgRam = (volatile uint32_t *) LABX_MBOX_DATA;
+  uint32_t words = (size / 4);
+  uint32_t word;
+  uint32_t idx;
+
+  /* Write the response words into the data buffer, zero-padding the last */
+  if(((ulong) buffer & 3) == 0) {
+    for(idx = 0; idx < words; idx++) {
+      msgRam[idx] = BYTES_TO_MBOX_WORD(((uint32_t *) buffer)[idx]);
+    }
+  } else {
+    for(idx = 0; idx < words; idx++) {
+      memcpy(&word, &buffer[idx * 4], 4);
+      msgRam[idx] = BYTES_TO_MBOX_WORD(word);
+    }
+  }
+  if(size & 3) {
+    word = 0;
+    memcpy(&word, &buffer[words * 4], (size & 3));
+    msgRam[words] = BYTES_TO_MBOX_WORD(word);
   }
   
   /* Commit the response message to the host */
@@ -55,7 +55,11 @@
 
 /* Public functions */
 extern void SetupLabXMailbox(void);
+extern void ShutdownLabXMailbox(void);
 extern int ReadLabXMailbox(uint8_t *buffer, uint32_t *size, uint8_t pollForMsg);
+#ifdef CONFIG_LABX_MAILBOX_ZERO_COPY
+extern uint8_t *PeekLabXMailbox(uint32_t *size, uint8_t pollForMsg);
+#endif
 extern void WriteLabXMailbox(uint8_t *buffer, uint32_t size);
 extern void TrigAsyncLabXMailbox(void);
 #endif
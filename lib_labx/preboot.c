@@ -56,6 +56,24 @@ static const char *crc_vars[][5] = {
 };
 static const unsigned int num_crcs = sizeof(crc_vars) / sizeof(crc_vars[0]);
 
+/* Size of the buffer through which image data is streamed from flash
+ * while its CRC is computed. */
+#ifndef CONFIG_LABX_PREBOOT_CRC_CHUNK
+#define CONFIG_LABX_PREBOOT_CRC_CHUNK (16 * 1024)
+#endif
+
+/* With CONFIG_LABX_PREBOOT_CRC_CACHE, each image which passes its CRC check
+ * at boot leaves a record in the environment, keyed by its location and
+ * header CRC, and is not checked again on later boots while the record
+ * stands. A record says nothing about the data behind the header, so every
+ * path which writes to flash must call labx_preboot_forget_verified() first. */
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+#ifndef CONFIG_ENV_IS_IN_SPI_FLASH
+#error "CONFIG_LABX_PREBOOT_CRC_CACHE keeps its records in the SPI flash environment"
+#endif
+#define CRC_RECORD_SUFFIX "vfy"
+#endif
+
 /* Pre-boot function. */
 int labx_preboot(int bootdelay) {
   if(labx_is_golden_fpga()) {
@@ -112,26 +130,96 @@ void labx_print_cmdhelp(void) {
 	puts("  'run bootglnx' to boot golden linux.\n");
 }
 
-static int check_crcs(const char *crc_vars[][5], int num) {
+#ifdef CONFIG_SPI_FLASH
+static struct spi_flash *spiflash = NULL;
+#endif
+
+// Computes the data CRC of an image straight out of flash, a chunk at a
+// time, rather than first staging the whole image in DDR. The chunk buffer
+// is kept small enough to stay cache-resident while it is CRC'd.
+static int crc_flash_image(unsigned int offset, unsigned int len,
+                           unsigned char *chunk, unsigned long *crc) {
+  unsigned int chunk_len;
+
+  *crc = 0;
+  while(len > 0) {
+    chunk_len = (len > CONFIG_LABX_PREBOOT_CRC_CHUNK) ? CONFIG_LABX_PREBOOT_CRC_CHUNK : len;
+#ifdef CONFIG_SPI_FLASH
+    if(spi_flash_read(spiflash, offset, chunk_len, chunk) != 0) return 0;
+    *crc = crc32(*crc, chunk, chunk_len);
+#else
+    *crc = crc32(*crc, (const unsigned char*)offset, chunk_len);
+#endif
+    offset += chunk_len;
+    len    -= chunk_len;
+  }
+
+  return 1;
+}
+
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+// Builds the name and value of an image's verification record. The record
+// no longer matches once the image moves or its header is replaced.
+static void make_crc_record(const char *start_name, unsigned int hdr_off,
+                            unsigned int start_off, const image_header_t *hdr,
+                            char *record_var, char *record) {
+  sprintf(record_var, "%s" CRC_RECORD_SUFFIX, start_name);
+  sprintf(record, "%x:%x:%08lx", hdr_off, start_off,
+          (unsigned long)image_get_hcrc(hdr));
+}
+
+// Removes the verification records of a set of images, returning nonzero
+// if any were present.
+static int forget_crc_records(const char *crc_vars[][5], int num) {
+  char record_var[32];
+  int i, found = 0;
+
+  for(i = 0; i < num; i++) {
+    sprintf(record_var, "%s" CRC_RECORD_SUFFIX, crc_vars[i][1]);
+    if(getenv(record_var)) {
+      setenv(record_var, NULL);
+      found = 1;
+    }
+  }
+  return found;
+}
+
+// Forgets every image verified on an earlier boot, so that all of them are
+// checked in full at the next one. This must be called, and must succeed,
+// before anything in flash is erased or written. Returns zero on success.
+int labx_preboot_forget_verified(void) {
+  int found = forget_crc_records(golden_crc_vars, num_golden_crcs);
+
+  found |= forget_crc_records(crc_vars, num_crcs);
+  if(found && saveenv()) {
+    puts("Failed to clear the verified image records.\n");
+    return -1;
+  }
+  return 0;
+}
+#endif
+
+static int check_crcs(const char *crc_vars[][5], int num, int use_records) {
   int success = 1;
   char start_var[11], hdr_var[11], *part_size_var;
   unsigned int i, start_off, hdr_off, part_size, crc_in_image;
   const unsigned int hdr_len = sizeof(image_header_t);
   static unsigned char *ddr = NULL;
   image_header_t *hdr_ddr;
-#ifdef CONFIG_SPI_FLASH
-  static struct spi_flash *spiflash = NULL;
+  unsigned long dcrc;
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+  char record_var[32], record[32], *recorded;
+  int records_changed = 0;
 #endif
 
-  // Use the start of DDR memory for temporary storage.
+  // Use the start of DDR memory for the header and chunk buffer.
   if(!ddr) {
     if(!(ddr = map_physmem(XPAR_DDR2_CONTROL_MPMC_BASEADDR, XPAR_DDR2_CONTROL_MPMC_HIGHADDR - XPAR_DDR2_CONTROL_MPMC_BASEADDR, MAP_WRBACK))) {
       printf("Failed to map physical memory at 0x%08X\n", XPAR_DDR2_CONTROL_MPMC_BASEADDR);
       return 0;
-    } else {
-      hdr_ddr = (image_header_t*)ddr;
     }
   }
+  hdr_ddr = (image_header_t*)ddr;
 
 #ifdef CONFIG_SPI_FLASH
   // Probe for flash device.
@@ -143,9 +231,9 @@ static int check_crcs(const char *crc_vars[][5], int num) {
   }
 #endif
 
-  // Loop over each flash image, copy it and its
-  // header from flash to DDR, and perform the CRC
-  // check based on the image and the CRC stored
+  // Loop over each flash image, fetch its header,
+  // and perform the CRC check by streaming the
+  // image data from flash against the CRC stored
   // within the header.
   for(i = 0; i < num; i++) {
     printf("Checking CRC for %s image... ", crc_vars[i][0]);
@@ -172,7 +260,7 @@ static int check_crcs(const char *crc_vars[][5], int num) {
 #ifdef CONFIG_SPI_FLASH
     spi_flash_read(spiflash, hdr_off, hdr_len, ddr);
 #else
-    memcpy(ddr, hdr_off, hdr_len);
+    memcpy(ddr, (const void*)(hdr_off), hdr_len);
 #endif
 
     // Sanity checks.
@@ -191,47 +279,77 @@ static int check_crcs(const char *crc_vars[][5], int num) {
       continue;
     }
 
-    // Data image.
-#ifdef CONFIG_SPI_FLASH
-    spi_flash_read(spiflash, start_off, hdr_ddr->ih_size, ddr + hdr_len);
-#else
-    memcpy(ddr + hdr_len, (const void*)(start_off), hdr_ddr->ih_size);
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+    // Skip images verified on an earlier boot and not written since.
+    make_crc_record(crc_vars[i][1], hdr_off, start_off, hdr_ddr, record_var, record);
+    if(use_records && image_check_hcrc(hdr_ddr) &&
+       ((recorded = getenv(record_var)) != NULL) && !strcmp(recorded, record)) {
+      puts("OK (verified on an earlier boot)\n");
+      continue;
+    }
 #endif
 
     // Perform CRC check.
-    if(image_check_dcrc(hdr_ddr)) {
+    if(!crc_flash_image(start_off, image_get_data_size(hdr_ddr), ddr + hdr_len, &dcrc)) {
+      puts("failed to read image data.\n");
+      success = 0;
+      continue;
+    }
+    printf("(checksum = 0x%08X) ", (unsigned int)dcrc);
+    if(dcrc == image_get_dcrc(hdr_ddr)) {
       puts("OK\n");
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+      if(use_records && image_check_hcrc(hdr_ddr)) {
+        recorded = getenv(record_var);
+        if(!recorded || strcmp(recorded, record)) {
+          setenv(record_var, record);
+          records_changed = 1;
+        }
+      }
+#endif
     } else {
       puts("Failed\n");
       success = 0;
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+      if(getenv(record_var)) {
+        setenv(record_var, NULL);
+        records_changed = 1;
+      }
+#endif
     }
   }
 
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+  // Persist any new or revoked verification records.
+  if(records_changed) saveenv();
+#endif
+
   // CRC check status.
   return success;
 }
 
+// The check commands always verify every image in full.
 int cmd_check_crcs(struct cmd_tbl_s* cmd_tbl, int flag, int argc, char *argv[]) {
-  int success = check_golden_crcs();
-  if(success == 0) success = check_runtime_crcs();
-  else check_runtime_crcs();
+  int success = check_crcs(golden_crc_vars, num_golden_crcs, 0);
+  if(success == 0) success = check_crcs(crc_vars, num_crcs, 0);
+  else check_crcs(crc_vars, num_crcs, 0);
   return !success;
 }
 
 int check_runtime_crcs(void) {
-  return check_crcs(crc_vars, num_crcs);
+  return check_crcs(crc_vars, num_crcs, 1);
 }
 
 int cmd_check_runtime_crcs(struct cmd_tbl_s* cmd_tbl, int flag, int argc, char *argv[]) {
-  return !check_runtime_crcs();
+  return !check_crcs(crc_vars, num_crcs, 0);
 }
 
 int check_golden_crcs(void) {
-  return check_crcs(golden_crc_vars, num_golden_crcs);
+  return check_crcs(golden_crc_vars, num_golden_crcs, 1);
 }
 
 int cmd_check_golden_crcs(struct cmd_tbl_s* cmd_tbl, int flag, int argc, char *argv[]) {
-  return !check_golden_crcs();
+  return !check_crcs(golden_crc_vars, num_golden_crcs, 0);
 }
 
 U_BOOT_CMD(checkg, 1, 1, cmd_check_golden_crcs,
@@ -14,6 +14,9 @@ int labx_is_golden_fpga(void);
 #ifdef CONFIG_LABX_PREBOOT
 int check_runtime_crcs(void);
 int check_golden_crcs(void);
+#ifdef CONFIG_LABX_PREBOOT_CRC_CACHE
+int labx_preboot_forget_verified(void);
+#endif
 #endif
 
 #endif /* LABXLIB_PREBOOT_H */
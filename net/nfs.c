@@ -32,11 +32,28 @@
 #define HASHES_PER_LINE 65	/* Number of "loading" hashes per line	*/
 #define NFS_RETRY_COUNT 30
 #define NFS_TIMEOUT 2000UL
+#define NFS_READ_STALE (-10000)	/* reply to a READ no longer in flight */
+
+#if NFS_READ_WINDOW < 1
+#error "CONFIG_NFS_READ_WINDOW must be at least 1"
+#endif
 
 static int fs_mounted = 0;
 static unsigned long rpc_id = 0;
-static int nfs_offset = -1;
-static int nfs_len;
+static unsigned int nfs_len;
+
+/* READ requests in flight; an xid of 0 marks a free slot */
+struct nfs_read_slot {
+	unsigned long xid;
+	unsigned int offset;
+	unsigned int len;
+};
+static struct nfs_read_slot nfs_read_slots[NFS_READ_WINDOW];
+static int nfs_read_window;		/* slots in use, 1 until size known */
+static unsigned int nfs_read_next;	/* next file offset to request */
+static unsigned int nfs_filesize;	/* from the READ reply attributes */
+static unsigned int nfs_rcvd;		/* bytes stored, for the hashes */
+static unsigned int nfs_hashes;
 
 static char dirfh[NFS_FHSIZE];	/* file handle of directory */
 static char filefh[NFS_FHSIZE]; /* file handle of kernel image */
@@ -346,6 +363,87 @@ nfs_read_req (int offset, int readlen)
 	rpc_req (PROG_NFS, NFS_READ, data, len);
 }
 
+static void
+nfs_read_issue (struct nfs_read_slot *slot, unsigned int offset,
+		unsigned int len)
+{
+	slot->offset = offset;
+	slot->len = len;
+	nfs_read_req (offset, len);
+	slot->xid = rpc_id;
+}
+
+/* Start the first READ; the window opens once the file size is known */
+static void
+nfs_read_start (void)
+{
+	memset (nfs_read_slots, 0, sizeof(nfs_read_slots));
+	nfs_len = NFS_READ_SIZE;
+	nfs_read_window = 1;
+	nfs_read_next = 0;
+	nfs_filesize = ~0U;
+	nfs_rcvd = 0;
+	nfs_hashes = 0;
+}
+
+/* Fill every free slot with a READ at the next offset not yet requested */
+static void
+nfs_read_fill (void)
+{
+	unsigned int len;
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_read_next >= nfs_filesize)
+			break;
+		if (nfs_read_slots[i].xid)
+			continue;
+		len = min(nfs_len, nfs_filesize - nfs_read_next);
+		nfs_read_issue (&nfs_read_slots[i], nfs_read_next, len);
+		nfs_read_next += len;
+	}
+}
+
+/* Send the READs still outstanding again, under new XIDs */
+static void
+nfs_read_resend (void)
+{
+	int i;
+
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_read_slots[i].xid)
+			nfs_read_issue (&nfs_read_slots[i],
+					nfs_read_slots[i].offset,
+					nfs_read_slots[i].len);
+	}
+}
+
+static int
+nfs_read_done (void)
+{
+	int i;
+
+	if (nfs_read_next < nfs_filesize)
+		return 0;
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_read_slots[i].xid)
+			return 0;
+	}
+	return 1;
+}
+
+static void
+nfs_read_progress (unsigned int rlen)
+{
+	nfs_rcvd += rlen;
+	while (nfs_rcvd >= nfs_hashes * ((NFS_READ_SIZE/2)*10)) {
+		if (nfs_hashes && !(nfs_hashes % HASHES_PER_LINE))
+			puts ("\n\t ");
+		putc ('#');
+		nfs_hashes++;
+	}
+}
+
 /**************************************************************************
 RPC request dispatcher
 **************************************************************************/
@@ -372,7 +470,7 @@ NfsSend (void)
 		nfs_lookup_req (nfs_filename);
 		break;
 	case STATE_READ_REQ:
-		nfs_read_req (nfs_offset, nfs_len);
+		nfs_read_resend ();
 		break;
 	case STATE_READLINK_REQ:
 		nfs_readlink_req ();
@@ -526,14 +624,24 @@ static int
 nfs_read_reply (uchar *pkt, unsigned len)
 {
 	struct rpc_t rpc_pkt;
-	int rlen;
+	struct nfs_read_slot *slot = NULL;
+	unsigned long id;
+	unsigned int rlen;
+	int i;
 
 	debug("%s\n", __func__);
 
 	memcpy ((uchar *)&rpc_pkt, pkt, sizeof(rpc_pkt.u.reply));
 
-	if (ntohl(rpc_pkt.u.reply.id) != rpc_id)
-		return -1;
+	id = ntohl(rpc_pkt.u.reply.id);
+	for (i = 0; i < nfs_read_window; i++) {
+		if (nfs_read_slots[i].xid == id) {
+			slot = &nfs_read_slots[i];
+			break;
+		}
+	}
+	if (!slot)
+		return NFS_READ_STALE;
 
 	if (rpc_pkt.u.reply.rstatus  ||
 	    rpc_pkt.u.reply.verifier ||
@@ -548,17 +656,25 @@ nfs_read_reply (uchar *pkt, unsigned len)
 		return -ntohl(rpc_pkt.u.reply.data[0]);;
 	}
 
-	if ((nfs_offset!=0) && !((nfs_offset) % (NFS_READ_SIZE/2*10*HASHES_PER_LINE))) {
-		puts ("\n\t ");
-	}
-	if (!(nfs_offset % ((NFS_READ_SIZE/2)*10))) {
-		putc ('#');
-	}
-
+	nfs_filesize = ntohl(rpc_pkt.u.reply.data[6]);
 	rlen = ntohl(rpc_pkt.u.reply.data[18]);
-	if ( store_block ((uchar *)pkt+sizeof(rpc_pkt.u.reply), nfs_offset, rlen) )
+	if (rlen > slot->len || sizeof(rpc_pkt.u.reply) + rlen > len)
 		return -9999;
 
+	if ( store_block ((uchar *)pkt+sizeof(rpc_pkt.u.reply), slot->offset, rlen) )
+		return -9999;
+	nfs_read_progress (rlen);
+
+	if (rlen && rlen < slot->len && slot->offset + rlen < nfs_filesize) {
+		/* The server caps its reads: ask for the rest, and no more
+		 * than it returned from now on */
+		if (rlen < nfs_len)
+			nfs_len = rlen;
+		nfs_read_issue (slot, slot->offset + rlen, slot->len - rlen);
+	} else {
+		slot->xid = 0;
+	}
+
 	return rlen;
 }
 
@@ -630,9 +746,8 @@ NfsHandler (uchar *pkt, unsigned dest, unsigned src, unsigned len)
 			NfsSend ();
 		} else {
 			NfsState = STATE_READ_REQ;
-			nfs_offset = 0;
-			nfs_len = NFS_READ_SIZE;
-			NfsSend ();
+			nfs_read_start ();
+			nfs_read_fill ();
 		}
 		break;
 
@@ -653,17 +768,24 @@ NfsHandler (uchar *pkt, unsigned dest, unsigned src, unsigned len)
 
 	case STATE_READ_REQ:
 		rlen = nfs_read_reply (pkt, len);
+		if (rlen == NFS_READ_STALE)
+			break;
 		NetSetTimeout (NFS_TIMEOUT, NfsTimeout);
-		if (rlen > 0) {
-			nfs_offset += rlen;
-			NfsSend ();
+		if (rlen >= 0) {
+			nfs_read_window = NFS_READ_WINDOW;
+			if (nfs_read_done ()) {
+				NfsDownloadState = NETLOOP_SUCCESS;
+				NfsState = STATE_UMOUNT_REQ;
+				NfsSend ();
+			} else {
+				nfs_read_fill ();
+			}
 		}
 		else if ((rlen == -NFSERR_ISDIR)||(rlen == -NFSERR_INVAL)) {
 			/* symbolic link */
 			NfsState = STATE_READLINK_REQ;
 			NfsSend ();
 		} else {
-			if ( ! rlen ) NfsDownloadState = NETLOOP_SUCCESS;
 			NfsState = STATE_UMOUNT_REQ;
 			NfsSend ();
 		}
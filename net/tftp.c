@@ -96,6 +96,22 @@ static char tftp_filename[MAX_LEN];
 extern flash_info_t flash_info[];
 #endif
 
+#ifdef CONFIG_SYS_DIRECT_SPI_FLASH_TFTP
+#include <spi_flash.h>
+
+/*
+ * When TftpSpiFlash is set (by the "tftpsf" command), the file is
+ * programmed into that SPI flash at TftpSpiFlashOffset as it arrives
+ * instead of being stored at load_addr. The CRC-32 of the data written
+ * is left in TftpSpiFlashCrc.
+ */
+struct spi_flash *TftpSpiFlash;
+ulong	TftpSpiFlashOffset;
+ulong	TftpSpiFlashCrc;
+static ulong TftpSpiFlashNext;		/* file offset of the next block	*/
+static ulong TftpSpiFlashErased;	/* end of the flash erased so far	*/
+#endif
+
 /* 512 is poor choice for ethernet, MTU is typically 1500.
  * Minus eth.hdrs thats 1468.  Can get 2x better throughput with
  * almost-MTU block sizes.  At least try... fall back to 512 if need be.
@@ -114,6 +130,26 @@ extern flash_info_t flash_info[];
 static unsigned short TftpBlkSize=TFTP_BLOCK_SIZE;
 static unsigned short TftpBlkSizeOption=TFTP_MTU_BLOCKSIZE;
 
+/* Number of blocks the server may send per ACK (RFC 7440); 1 is plain
+ * stop-and-wait, and the option is only requested when it is larger.
+ */
+#ifdef CONFIG_TFTP_WINDOWSIZE
+#define TFTP_WINDOWSIZE CONFIG_TFTP_WINDOWSIZE
+#else
+#define TFTP_WINDOWSIZE 1
+#endif
+
+/* Within a window a lost block is noticed by the gap that follows it, so
+ * a lost window tail is the only thing left to the timer; poll for it
+ * more often than the stop-and-wait timeout, over the same total time.
+ */
+#define TFTP_WINDOW_TIMEOUT_DIV	5
+
+static unsigned short TftpWindowSize=1;
+static unsigned short TftpWindowSizeOption=TFTP_WINDOWSIZE;
+static ulong	TftpNextAck;		/* block that completes the current window */
+static int	TftpWindowResync;	/* ACK already sent for a gap in this window */
+
 #ifdef CONFIG_MCAST_TFTP
 #include <malloc.h>
 #define MTFTP_BITMAPSIZE	0x1000
@@ -139,14 +175,77 @@ mcast_cleanup(void)
 
 #endif	/* CONFIG_MCAST_TFTP */
 
-static __inline__ void
+#ifdef CONFIG_SYS_DIRECT_SPI_FLASH_TFTP
+/*
+ * Program one block into SPI flash. Blocks are stored strictly in
+ * order, so each sector is erased as the stream first reaches it and
+ * the CRC can be kept running; a transfer that starts again from the
+ * first block starts the erase and the CRC over.
+ */
+static int
+store_block_spi_flash (ulong offset, uchar *src, unsigned len)
+{
+	struct spi_flash *flash = TftpSpiFlash;
+	ulong addr = TftpSpiFlashOffset + offset;
+	ulong erase_len;
+
+	if (offset == 0) {
+		TftpSpiFlashErased = TftpSpiFlashOffset;
+		TftpSpiFlashCrc = 0;
+	} else if (offset != TftpSpiFlashNext) {
+		puts ("\nSPI flash: block out of sequence\n");
+		return -1;
+	}
+
+	if (addr + len > flash->size) {
+		puts ("\nSPI flash: file does not fit in flash\n");
+		return -1;
+	}
+
+	if (addr + len > TftpSpiFlashErased) {
+		erase_len = roundup(addr + len - TftpSpiFlashErased,
+					flash->sector_size);
+		if (TftpSpiFlashErased + erase_len > flash->size)
+			erase_len = flash->size - TftpSpiFlashErased;
+		if (spi_flash_erase (flash, TftpSpiFlashErased, erase_len)) {
+			puts ("\nSPI flash: erase failed\n");
+			return -1;
+		}
+		TftpSpiFlashErased += erase_len;
+	}
+
+	if (spi_flash_write (flash, addr, len, src)) {
+		puts ("\nSPI flash: write failed\n");
+		return -1;
+	}
+
+	TftpSpiFlashCrc = crc32 (TftpSpiFlashCrc, src, len);
+	TftpSpiFlashNext = offset + len;
+	return 0;
+}
+#endif /* CONFIG_SYS_DIRECT_SPI_FLASH_TFTP */
+
+static __inline__ int
 store_block (unsigned block, uchar * src, unsigned len)
 {
 	ulong offset = block * TftpBlkSize + TftpBlockWrapOffset;
 	ulong newsize = offset + len;
 #ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 	int i, rc = 0;
+#endif
 
+#ifdef CONFIG_SYS_DIRECT_SPI_FLASH_TFTP
+	if (TftpSpiFlash) {
+		if (store_block_spi_flash (offset, src, len)) {
+			NetState = NETLOOP_FAIL;
+			return -1;
+		}
+		if (NetBootFileXferSize < newsize)
+			NetBootFileXferSize = newsize;
+		return 0;
+	}
+#endif
+#ifdef CONFIG_SYS_DIRECT_FLASH_TFTP
 	for (i=0; i<CONFIG_SYS_MAX_FLASH_BANKS; i++) {
 		/* start address in flash? */
 		if (flash_info[i].flash_id == FLASH_UNKNOWN)
@@ -162,7 +261,7 @@ store_block (unsigned block, uchar * src, unsigned len)
 		if (rc) {
 			flash_perror (rc);
 			NetState = NETLOOP_FAIL;
-			return;
+			return -1;
 		}
 	}
 	else
@@ -177,11 +276,28 @@ store_block (unsigned block, uchar * src, unsigned len)
 
 	if (NetBootFileXferSize < newsize)
 		NetBootFileXferSize = newsize;
+	return 0;
 }
 
 static void TftpSend (void);
 static void TftpTimeout (void);
 
+static ulong
+TftpDataTimeout (void)
+{
+	if (TftpWindowSize > 1)
+		return TftpTimeoutMSecs / TFTP_WINDOW_TIMEOUT_DIV;
+	return TftpTimeoutMSecs;
+}
+
+static int
+TftpDataTimeoutCount (void)
+{
+	if (TftpWindowSize > 1)
+		return TIMEOUT_COUNT * TFTP_WINDOW_TIMEOUT_DIV;
+	return TIMEOUT_COUNT;
+}
+
 /**********************************************************************/
 
 static void
@@ -228,6 +344,9 @@ TftpSend (void)
 		/* try for more effic. blk size */
 		pkt += sprintf((char *)pkt,"blksize%c%d%c",
 				0,TftpBlkSizeOption,0);
+		if (TftpWindowSizeOption > 1)
+			pkt += sprintf((char *)pkt,"windowsize%c%d%c",
+					0,TftpWindowSizeOption,0);
 #ifdef CONFIG_MCAST_TFTP
 		/* Check all preconditions before even trying the option */
 		if (!ProhibitMcast
@@ -337,6 +456,15 @@ TftpHandler (uchar * pkt, unsigned dest, unsigned src, unsigned len)
 				debug("Blocksize ack: %s, %d\n",
 					(char*)pkt+i+8,TftpBlkSize);
 			}
+			if (strcmp ((char*)pkt+i,"windowsize") == 0) {
+				TftpWindowSize = (unsigned short)
+					simple_strtoul((char*)pkt+i+11,NULL,10);
+				if (TftpWindowSize < 1 ||
+				    TftpWindowSize > TftpWindowSizeOption)
+					TftpWindowSize = 1;
+				debug("Windowsize ack: %s, %d\n",
+					(char*)pkt+i+11,TftpWindowSize);
+			}
 #ifdef CONFIG_TFTP_TSIZE
 			if (strcmp ((char*)pkt+i,"tsize") == 0) {
 				TftpTsize = simple_strtoul((char*)pkt+i+6,NULL,10);
@@ -347,6 +475,8 @@ TftpHandler (uchar * pkt, unsigned dest, unsigned src, unsigned len)
 		}
 #ifdef CONFIG_MCAST_TFTP
 		parse_multicast_oack((char *)pkt,len-1);
+		if (Multicast)
+			TftpWindowSize = 1;	/* blocks are ACKed out of order */
 		if ((Multicast) && (!MasterClient))
 			TftpState = STATE_DATA;	/* passive.. */
 		else
@@ -359,6 +489,27 @@ TftpHandler (uchar * pkt, unsigned dest, unsigned src, unsigned len)
 		len -= 2;
 		TftpBlock = ntohs(*(ushort *)pkt);
 
+		/*
+		 * With a window open, only the block following the last one
+		 * stored is accepted.  Anything else means a block was lost
+		 * or the server is repeating itself; ACK the last block in
+		 * sequence, once, so the server restarts the window from
+		 * the first block missing.
+		 */
+		if (TftpState == STATE_DATA && TftpWindowSize > 1 &&
+		    TftpBlock != ((TftpLastBlock + 1) % TFTP_SEQUENCE_SIZE)) {
+			debug("Got block %lu, expected %lu\n", TftpBlock,
+				(TftpLastBlock + 1) % TFTP_SEQUENCE_SIZE);
+			TftpBlock = TftpLastBlock;
+			if (!TftpWindowResync) {
+				TftpWindowResync = 1;
+				TftpNextAck = (TftpLastBlock + TftpWindowSize) %
+						TFTP_SEQUENCE_SIZE;
+				TftpSend ();
+			}
+			break;
+		}
+
 		/*
 		 * RFC1350 specifies that the first data packet will
 		 * have sequence number 1. If we receive a sequence
@@ -404,6 +555,8 @@ TftpHandler (uchar * pkt, unsigned dest, unsigned src, unsigned len)
 			TftpLastBlock = 0;
 			TftpBlockWrap = 0;
 			TftpBlockWrapOffset = 0;
+			TftpNextAck = TftpWindowSize;
+			TftpWindowResync = 0;
 
 #ifdef CONFIG_MCAST_TFTP
 			if (Multicast) { /* start!=1 common if mcast */
@@ -428,10 +581,18 @@ TftpHandler (uchar * pkt, unsigned dest, unsigned src, unsigned len)
 		}
 
 		TftpLastBlock = TftpBlock;
-		TftpTimeoutCountMax = TIMEOUT_COUNT;
-		NetSetTimeout (TftpTimeoutMSecs, TftpTimeout);
+		TftpWindowResync = 0;
+		TftpTimeoutCountMax = TftpDataTimeoutCount ();
+		NetSetTimeout (TftpDataTimeout (), TftpTimeout);
 
-		store_block (TftpBlock - 1, pkt + 2, len);
+		/*
+		 *	A block that could not be stored fails the transfer;
+		 *	nothing after it is acknowledged or may complete it,
+		 *	even if more frames were received in the same poll.
+		 */
+		if (NetState == NETLOOP_FAIL ||
+		    store_block (TftpBlock - 1, pkt + 2, len))
+			break;
 
 		/*
 		 *	Acknoledge the block just received, which will prompt
@@ -461,8 +622,19 @@ TftpHandler (uchar * pkt, unsigned dest, unsigned src, unsigned len)
 				TftpLastBlock = TftpBlock;
 			}
 		}
+		if (Multicast)
+			TftpSend ();
+		else
 #endif
-		TftpSend ();
+		/*
+		 * A window is acknowledged as a whole, by its last block,
+		 * and the final short block always is.
+		 */
+		if (TftpBlock == TftpNextAck || len < TftpBlkSize) {
+			TftpNextAck = (TftpBlock + TftpWindowSize) %
+					TFTP_SEQUENCE_SIZE;
+			TftpSend ();
+		}
 
 #ifdef CONFIG_MCAST_TFTP
 		if (Multicast) {
@@ -550,7 +722,15 @@ TftpTimeout (void)
 		          GARCIA_FPGA_STATUS_LED_FLASH | GARCIA_FPGA_POWER_LED_B);
 		}
 #endif
-		NetSetTimeout (TftpTimeoutMSecs, TftpTimeout);
+		if (TftpState == STATE_DATA) {
+			/* ACK the last block in sequence to restart the window */
+			TftpNextAck = (TftpLastBlock + TftpWindowSize) %
+					TFTP_SEQUENCE_SIZE;
+			TftpWindowResync = 0;
+			NetSetTimeout (TftpDataTimeout (), TftpTimeout);
+		} else {
+			NetSetTimeout (TftpTimeoutMSecs, TftpTimeout);
+		}
 		TftpSend ();
 	}
 }
@@ -571,6 +751,9 @@ TftpStart (void)
 	if ((ep = getenv("tftptimeout")) != NULL)
 		TftpTimeoutMSecs = simple_strtol(ep, NULL, 10);
 
+	if ((ep = getenv("tftpwindowsize")) != NULL)
+		TftpWindowSizeOption = simple_strtol(ep, NULL, 10);
+
 	if (TftpTimeoutMSecs < 1000) {
 		printf("TFTP timeout (%ld ms) too low, "
 			"set minimum = 1000 ms\n",
@@ -578,8 +761,8 @@ TftpStart (void)
 		TftpTimeoutMSecs = 1000;
 	}
 
-	debug("TFTP blocksize = %i, timeout = %ld ms\n",
-		TftpBlkSizeOption, TftpTimeoutMSecs);
+	debug("TFTP blocksize = %i, windowsize = %i, timeout = %ld ms\n",
+		TftpBlkSizeOption, TftpWindowSizeOption, TftpTimeoutMSecs);
 
 	TftpServerIP = NetServerIP;
 	if (BootFile[0] == '\0') {
@@ -659,8 +842,9 @@ TftpStart (void)
 
 	/* zero out server ether in case the server ip has changed */
 	memset(NetServerEther, 0, 6);
-	/* Revert TftpBlkSize to dflt */
+	/* Revert TftpBlkSize and TftpWindowSize to dflt */
 	TftpBlkSize = TFTP_BLOCK_SIZE;
+	TftpWindowSize = 1;
 #ifdef CONFIG_MCAST_TFTP
 	mcast_cleanup();
 #endif
@@ -0,0 +1,232 @@
+/*
+ * crc32check - check that lib/crc32.c built with CONFIG_CRC32_SLICE 4 and
+ * 8 computes the same CRC-32 as the byte-wise build, and report how fast
+ * each build runs on the build host.
+ *
+ * Every build is compared with a bit-at-a-time reference over random
+ * lengths, buffer alignments and starting CRCs, in one call and split
+ * into two calls the way the chunked image checks use it.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef uint32_t (*crc_fn)(uint32_t, const unsigned char *, unsigned int);
+
+uint32_t crc32_s1(uint32_t, const unsigned char *, unsigned int);
+uint32_t crc32_s4(uint32_t, const unsigned char *, unsigned int);
+uint32_t crc32_s8(uint32_t, const unsigned char *, unsigned int);
+uint32_t crc32_no_comp_s1(uint32_t, const unsigned char *, unsigned int);
+uint32_t crc32_no_comp_s4(uint32_t, const unsigned char *, unsigned int);
+uint32_t crc32_no_comp_s8(uint32_t, const unsigned char *, unsigned int);
+
+static const struct variant {
+	const char	*name;
+	crc_fn		crc32;
+	crc_fn		crc32_no_comp;
+} variants[] = {
+	{ "byte-wise",	crc32_s1, crc32_no_comp_s1 },
+	{ "slice-by-4",	crc32_s4, crc32_no_comp_s4 },
+	{ "slice-by-8",	crc32_s8, crc32_no_comp_s8 },
+};
+
+#define NUM_VARIANTS	(sizeof(variants) / sizeof(variants[0]))
+
+/* Longest buffer of the random cases, beyond a few sliced blocks */
+#define MAX_CHECK_LEN	4200
+/* Alignments tried, past the widest load the sliced loops make */
+#define MAX_ALIGN	16
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+/* Reflected CRC-32 one bit at a time, shares nothing with lib/crc32.c */
+static uint32_t crc32_ref(uint32_t crc, const unsigned char *buf,
+		unsigned int len)
+{
+	int bit;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *buf++;
+		for (bit = 0; bit < 8; bit++)
+			crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+static unsigned int check_case(const unsigned char *buf, unsigned int len,
+		uint32_t init, unsigned int split)
+{
+	uint32_t expected = crc32_ref(init, buf, len);
+	uint32_t expected_nc = ~crc32_ref(~init, buf, len);
+	uint32_t crc;
+	unsigned int i, failures = 0;
+
+	for (i = 0; i < NUM_VARIANTS; i++) {
+		const struct variant *v = &variants[i];
+
+		crc = v->crc32(init, buf, len);
+		if (crc != expected) {
+			fprintf(stderr, "%s: crc32 0x%08x, expected 0x%08x "
+				"(len %u, align %lu, init 0x%08x)\n",
+				v->name, crc, expected, len,
+				(unsigned long)buf % MAX_ALIGN, init);
+			failures++;
+		}
+
+		crc = v->crc32(v->crc32(init, buf, split), buf + split,
+			len - split);
+		if (crc != expected) {
+			fprintf(stderr, "%s: crc32 split at %u 0x%08x, "
+				"expected 0x%08x (len %u, align %lu)\n",
+				v->name, split, crc, expected, len,
+				(unsigned long)buf % MAX_ALIGN);
+			failures++;
+		}
+
+		crc = v->crc32_no_comp(init, buf, len);
+		if (crc != expected_nc) {
+			fprintf(stderr, "%s: crc32_no_comp 0x%08x, expected "
+				"0x%08x (len %u, align %lu, init 0x%08x)\n",
+				v->name, crc, expected_nc, len,
+				(unsigned long)buf % MAX_ALIGN, init);
+			failures++;
+		}
+	}
+	return failures;
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -n count      random cases to check (default 20000)\n"
+		"  -s size       buffer size of the benchmark (default 0x400000)\n"
+		"  -r count      benchmark passes over the buffer (default 64)\n"
+		"  -S seed       seed of the random cases (default 1)\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long cases = 20000;
+	unsigned long size = 0x400000;
+	unsigned long passes = 64;
+	unsigned long n, p;
+	unsigned int failures = 0;
+	unsigned int i, len, align;
+	unsigned char *buf, *big;
+	unsigned long long start, ns;
+	uint32_t crc, expected;
+	int opt;
+
+	rng_state = 1;
+	while ((opt = getopt(argc, argv, "n:s:r:S:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			cases = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			size = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			passes = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			rng_state = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (!size || !passes || !rng_state) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	buf = malloc(MAX_CHECK_LEN + MAX_ALIGN);
+	big = malloc(size);
+	if (!buf || !big) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return 1;
+	}
+
+	/* The reference itself, against the standard check value */
+	if (crc32_ref(0, (const unsigned char *)"123456789", 9) != 0xcbf43926) {
+		fprintf(stderr, "%s: reference CRC is broken\n", argv[0]);
+		return 1;
+	}
+
+	/* Equivalence: every short length and alignment, then random cases */
+	for (i = 0; i < MAX_CHECK_LEN + MAX_ALIGN; i++)
+		buf[i] = rng();
+	for (len = 0; len <= 64; len++) {
+		for (align = 0; align < MAX_ALIGN; align++)
+			failures += check_case(buf + align, len, 0, len / 2);
+	}
+	for (n = 0; n < cases && failures < 20; n++) {
+		len = rng() % (MAX_CHECK_LEN + 1);
+		align = rng() % MAX_ALIGN;
+		for (i = 0; i < len; i++)
+			buf[align + i] = rng();
+		failures += check_case(buf + align, len, rng(),
+			len ? rng() % (len + 1) : 0);
+	}
+
+	printf("%lu random cases and all lengths up to 64: %s\n\n",
+		cases, failures ? "FAILED" : "OK");
+
+	/* Throughput over one large, aligned buffer */
+	for (n = 0; n < size; n++)
+		big[n] = rng();
+	expected = crc32_ref(0, big, size);
+
+	printf("%lu passes over %lu bytes:\n", passes, size);
+	for (i = 0; i < NUM_VARIANTS; i++) {
+		const struct variant *v = &variants[i];
+
+		crc = v->crc32(0, big, size);
+		start = now_ns();
+		for (p = 0; p < passes; p++)
+			crc = v->crc32(0, big, size);
+		ns = now_ns() - start;
+
+		if (crc != expected) {
+			fprintf(stderr, "%s: crc32 0x%08x, expected 0x%08x "
+				"over the benchmark buffer\n",
+				v->name, crc, expected);
+			failures++;
+		}
+		printf("  %-12s %9.1f MB/s\n", v->name,
+			ns ? (double)size * passes * 1000.0 / ns : 0.0);
+	}
+
+	free(buf);
+	free(big);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,258 @@
+/*
+ * idlcheck - round-trip every message of an IDL module through the code
+ * generated for it by lib_labx/idl/labx_c.py, on the build host.
+ *
+ * Each request is marshalled by the generated client stub, with the generic
+ * accessors of message-buffer.c, and handed straight to the generated
+ * unmarshal code the boot loader runs, with its fixed-offset accessors and
+ * dispatch tables.  The handlers generated by labx_check.py check what they
+ * receive and answer; the stub unmarshals the response and the check
+ * compares it with the expected values.  A benchmark of the dispatch of
+ * every message follows.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "AvbDefs.h"
+#include "idlcheck.h"
+
+#define NUM_STRINGS	4
+#define MAX_STRING	64
+
+uint32_t idlcheck_seed;
+unsigned int idlcheck_calls;
+int idlcheck_bench;
+
+/* Class code of the module, defined by its stub */
+extern ClassCode k_CC;
+
+static RequestMessageBuffer_t last_request;
+static ResponseMessageBuffer_t last_response;
+static unsigned int failures;
+
+void idlcheck_fail(const char *message, const char *what)
+{
+	if (++failures <= 20)
+		fprintf(stderr, "%s: %s differs (seed %u)\n",
+			message, what, idlcheck_seed);
+}
+
+/* Strings handed to the stubs; a few stay valid at once */
+string_t idlcheck_string(uint32_t seed)
+{
+	static char strings[NUM_STRINGS][MAX_STRING];
+	static unsigned int next;
+	char *s = strings[next++ % NUM_STRINGS];
+	uint32_t i, len = seed % MAX_STRING;
+
+	for (i = 0; i < len; i++)
+		s[i] = 'a' + IDLCHECK_SEED(seed, i) % 26;
+	s[len] = '\0';
+	return s;
+}
+
+/* The transport of the stubs: straight into the boot loader's unmarshal code */
+void SendMessage(RequestMessageBuffer_t request, ResponseMessageBuffer_t response)
+{
+	memcpy(last_request, request, sizeof(last_request));
+
+	/* Anything left unwritten by the unmarshal code shows up */
+	memset(response, 0xa5, sizeof(ResponseMessageBuffer_t));
+	idlcheck_dispatch(request, response);
+	memcpy(last_response, response, sizeof(last_response));
+}
+
+/* Compare the last response with one marshalled the generic way */
+void idlcheck_response(const char *message, ResponseMessageBuffer_t expected,
+		uint32_t length)
+{
+	if (getLength_resp(last_response) != length)
+		idlcheck_fail(message, "response length");
+	else if (memcmp(&last_response[RESP_PAYLOAD_OFFSET],
+			&expected[RESP_PAYLOAD_OFFSET],
+			length - RESP_PAYLOAD_OFFSET) != 0)
+		idlcheck_fail(message, "response payload");
+}
+
+/* Send a request which must be answered with "status" and no handler call */
+void idlcheck_refused(const char *message, uint16_t serviceCode,
+		uint16_t attributeCode, uint16_t status)
+{
+	RequestMessageBuffer_t request;
+	ResponseMessageBuffer_t response;
+
+	setClassCode_req(request, k_CC);
+	setInstanceNumber_req(request, 0);
+	setServiceCode_req(request, serviceCode);
+	setAttributeCode_req(request, attributeCode);
+	setLength_req(request, getPayloadOffset_req(request));
+
+	idlcheck_calls = 0;
+	SendMessage(request, response);
+	if (idlcheck_calls != 0)
+		idlcheck_fail(message, "handler calls");
+	if (getStatusCode_resp(response) != status)
+		idlcheck_fail(message, "status");
+	if (getLength_resp(response) != RESP_PAYLOAD_OFFSET)
+		idlcheck_fail(message, "response length");
+}
+
+/*
+ * The header offsets and in-line accessors of message-buffer.h, used by the
+ * unmarshal code, must agree with the accessor functions used by the stubs.
+ */
+static void check_header(uint32_t seed)
+{
+	MessageBuffer_t msg;
+	uint16_t v = IDLCHECK_SEED(seed, 0);
+	uint32_t v32 = IDLCHECK_SEED(seed, 1), got32;
+	uint8_t got8;
+
+	idlcheck_seed = seed;
+	if (getPayloadOffset_req(msg) != REQ_PAYLOAD_OFFSET)
+		idlcheck_fail("header", "REQ_PAYLOAD_OFFSET");
+	if (getPayloadOffset_resp(msg) != RESP_PAYLOAD_OFFSET)
+		idlcheck_fail("header", "RESP_PAYLOAD_OFFSET");
+
+	/* Each field, written one way and read back the other */
+	setLength_req(msg, v);
+	if (MSG_GET_UINT16(msg, REQ_LENGTH_OFFSET) != v)
+		idlcheck_fail("header", "REQ_LENGTH_OFFSET");
+	setClassCode_req(msg, v + 1);
+	if (MSG_GET_UINT16(msg, REQ_CLASS_CODE_OFFSET) != (uint16_t) (v + 1))
+		idlcheck_fail("header", "REQ_CLASS_CODE_OFFSET");
+	setInstanceNumber_req(msg, v + 2);
+	if (MSG_GET_UINT16(msg, REQ_INSTANCE_NUMBER_OFFSET) != (uint16_t) (v + 2))
+		idlcheck_fail("header", "REQ_INSTANCE_NUMBER_OFFSET");
+	setServiceCode_req(msg, v + 3);
+	if (MSG_GET_UINT16(msg, REQ_SERVICE_CODE_OFFSET) != (uint16_t) (v + 3))
+		idlcheck_fail("header", "REQ_SERVICE_CODE_OFFSET");
+	setAttributeCode_req(msg, v + 4);
+	if (MSG_GET_UINT16(msg, REQ_ATTRIBUTE_CODE_OFFSET) != (uint16_t) (v + 4))
+		idlcheck_fail("header", "REQ_ATTRIBUTE_CODE_OFFSET");
+
+	/* Fields written after the others must not have overwritten them */
+	if ((getLength_req(msg) != v) ||
+	    (getClassCode_req(msg) != (uint16_t) (v + 1)) ||
+	    (getServiceCode_req(msg) != (uint16_t) (v + 3)) ||
+	    (getAttributeCode_req(msg) != (uint16_t) (v + 4)))
+		idlcheck_fail("header", "request fields");
+
+	MSG_SET_UINT16(msg, RESP_LENGTH_OFFSET, v);
+	MSG_SET_UINT16(msg, RESP_STATUS_OFFSET, v + 1);
+	if (getLength_resp(msg) != v)
+		idlcheck_fail("header", "RESP_LENGTH_OFFSET");
+	if (getStatusCode_resp(msg) != (uint16_t) (v + 1))
+		idlcheck_fail("header", "RESP_STATUS_OFFSET");
+
+	/* The in-line accessors against the marshalling functions */
+	MSG_SET_UINT32(msg, 5, v32);
+	uint32_t_unmarshal(msg, 5, &got32);
+	if (got32 != v32)
+		idlcheck_fail("header", "MSG_SET_UINT32");
+	uint32_t_marshal(msg, 7, &v32);
+	if (MSG_GET_UINT32(msg, 7) != v32)
+		idlcheck_fail("header", "MSG_GET_UINT32");
+	MSG_SET_UINT8(msg, 3, v32);
+	uint8_t_unmarshal(msg, 3, &got8);
+	if ((got8 != (uint8_t) v32) || (MSG_GET_UINT8(msg, 3) != got8))
+		idlcheck_fail("header", "MSG_GET_UINT8");
+}
+
+static unsigned long long now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -n count      round trips of each message (default 1000)\n"
+		"  -r count      dispatches of each message benchmarked (default 200000)\n"
+		"  -S seed       seed of the first round trip (default 1)\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const struct idlcheck_message *m;
+	RequestMessageBuffer_t request;
+	ResponseMessageBuffer_t response;
+	unsigned long rounds = 1000;
+	unsigned long passes = 200000;
+	unsigned long n, i;
+	unsigned int num_messages = 0;
+	uint32_t seed = 1;
+	unsigned long long start, ns;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:r:S:h")) != -1) {
+		switch (opt) {
+		case 'n':
+			rounds = strtoul(optarg, NULL, 0);
+			break;
+		case 'r':
+			passes = strtoul(optarg, NULL, 0);
+			break;
+		case 'S':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	for (n = 0; n < rounds; n++)
+		check_header(seed + n);
+
+	/* Codes without a handler */
+	idlcheck_refused("service 0x0003", 3, 0, e_EC_INVALID_SERVICE_CODE);
+	idlcheck_refused("service 0xffff", 0xffff, 0,
+		e_EC_INVALID_SERVICE_CODE);
+	idlcheck_refused("get attribute 0x0000", k_SC_getAttribute, 0,
+		e_EC_INVALID_ATTRIBUTE_CODE);
+	idlcheck_refused("get attribute 0xffff", k_SC_getAttribute, 0xffff,
+		e_EC_INVALID_ATTRIBUTE_CODE);
+	idlcheck_refused("set attribute 0x7fff", k_SC_setAttribute,
+		MIN_ATTRIBUTE_CODE - 1, e_EC_INVALID_ATTRIBUTE_CODE);
+
+	for (m = idlcheck_messages; m->name; m++)
+		num_messages++;
+	for (n = 0; n < rounds; n++) {
+		for (m = idlcheck_messages; m->name; m++)
+			m->check(seed + n);
+	}
+
+	printf("%u messages, %lu round trips each: %s\n\n", num_messages,
+		rounds, failures ? "FAILED" : "OK");
+
+	/* Dispatch of the last request of each message, as the boot loader sees it */
+	printf("%lu dispatches of each message:\n", passes);
+	for (m = idlcheck_messages; m->name; m++) {
+		m->check(seed);
+		memcpy(request, last_request, sizeof(request));
+
+		idlcheck_bench = 1;
+		start = now_ns();
+		for (i = 0; i < passes; i++)
+			idlcheck_dispatch(request, response);
+		ns = now_ns() - start;
+		idlcheck_bench = 0;
+
+		printf("  %-40s %4u bytes %8.1f ns\n", m->name,
+			getLength_req(request), passes ? (double)ns / passes : 0.0);
+	}
+
+	return failures ? 1 : 0;
+}
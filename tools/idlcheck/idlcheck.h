@@ -0,0 +1,41 @@
+/*
+ * Interface between the idlcheck driver and the round-trip check which the
+ * labx_check back end generates for an IDL module.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __IDLCHECK_H__
+#define __IDLCHECK_H__
+
+#include "message-buffer.h"
+
+/* Value of the n'th field of something derived from a seed */
+#define IDLCHECK_SEED(seed, n)	(((uint32_t) (seed) + (uint32_t) (n) + 1) * 2654435761u)
+
+/* Longest sequence generated; keeps every message within MAX_MSG_BUF_SIZE */
+#define IDLCHECK_MAX_SEQUENCE	512
+
+struct idlcheck_message {
+	const char	*name;
+	void		(*check)(uint32_t seed);
+};
+
+/* Generated for the module */
+extern const struct idlcheck_message idlcheck_messages[];
+extern void idlcheck_dispatch(RequestMessageBuffer_t request,
+		ResponseMessageBuffer_t response);
+
+/* Supplied by the driver */
+extern uint32_t idlcheck_seed;		/* seed of the message being checked */
+extern unsigned int idlcheck_calls;	/* handler calls since it was set */
+extern int idlcheck_bench;		/* handlers skip their checks */
+
+extern void idlcheck_fail(const char *message, const char *what);
+extern string_t idlcheck_string(uint32_t seed);
+extern void idlcheck_response(const char *message,
+		ResponseMessageBuffer_t expected, uint32_t length);
+extern void idlcheck_refused(const char *message, uint16_t serviceCode,
+		uint16_t attributeCode, uint16_t status);
+
+#endif /* __IDLCHECK_H__ */
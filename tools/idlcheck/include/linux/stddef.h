@@ -0,0 +1,12 @@
+/*
+ * NULL and offsetof() for the host build of the IDL generated code.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __IDLCHECK_LINUX_STDDEF_H__
+#define __IDLCHECK_LINUX_STDDEF_H__
+
+#include <stddef.h>
+
+#endif /* __IDLCHECK_LINUX_STDDEF_H__ */
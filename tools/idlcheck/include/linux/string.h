@@ -0,0 +1,12 @@
+/*
+ * String functions for the host build of message-buffer.c.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __IDLCHECK_LINUX_STRING_H__
+#define __IDLCHECK_LINUX_STRING_H__
+
+#include <string.h>
+
+#endif /* __IDLCHECK_LINUX_STRING_H__ */
@@ -0,0 +1,13 @@
+/*
+ * Fixed-size types for the host build of the IDL generated code.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __IDLCHECK_LINUX_TYPES_H__
+#define __IDLCHECK_LINUX_TYPES_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#endif /* __IDLCHECK_LINUX_TYPES_H__ */
@@ -0,0 +1,12 @@
+/*
+ * The host build of message-buffer.c allocates from the host heap.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __IDLCHECK_MALLOC_H__
+#define __IDLCHECK_MALLOC_H__
+
+#include <stdlib.h>
+
+#endif /* __IDLCHECK_MALLOC_H__ */
@@ -0,0 +1,358 @@
+# omniidl back end generating a host round-trip check of the code which the
+# labx_c back end generates for a module.  For every operation it outputs
+#
+#   - a handler, standing in for the boot loader's implementation, which
+#     checks the input parameters the unmarshal code passed it and answers
+#     with known output parameters and status;
+#   - a check, which calls the operation's stub with known input parameters
+#     and checks the output parameters and status it gets back, as well as
+#     the response itself against one marshalled the generic way.
+#
+# The values are derived from a seed chosen by the caller, so that the same
+# value can be computed independently on either side.  See tools/idlcheck.
+
+from omniidl import idlast, idlvisitor, idlutil, idltype
+from omniidl_be.cxx import output
+import sys
+
+import labx_c
+
+eNone, eGetter, eSetter = labx_c.eNone, labx_c.eGetter, labx_c.eSetter
+
+intKinds = [idltype.tk_octet, idltype.tk_char, idltype.tk_short, idltype.tk_ushort,
+            idltype.tk_long, idltype.tk_ulong, idltype.tk_longlong, idltype.tk_ulonglong]
+
+# Offset of the seeds of the output parameters from those of the inputs
+OUT_SEED = 100
+
+def typeName(t):
+    v = labx_c.CxxTypeVisitor()
+    t.accept(v)
+    return v.getResultType()
+
+def isBasetype(t):
+    v = labx_c.CxxTypeVisitor()
+    t.accept(v)
+    return v.isResultBasetype()
+
+# Emits, once per C type, the functions filling in a value of the type from a
+# seed and comparing two values of it
+class ValueHelpers:
+
+    def __init__(self, st):
+        self.st = st
+        self.done = set()
+
+    def need(self, t):
+        name = typeName(t)
+        if name in self.done:
+            return name
+        u = t.unalias()
+        kind = u.kind()
+        st = self.st
+
+        if kind == idltype.tk_struct:
+            members = []
+            for m in u.decl().members():
+                members.append((self.need(m.memberType()), m.declarators()))
+        elif kind == idltype.tk_sequence:
+            element = self.need(u.seqType())
+
+        self.done.add(name)
+        st.out("static void fill_@n@(@n@ *v, uint32_t seed)", n=name)
+        st.out("{")
+        st.inc_indent()
+        if kind in intKinds:
+            st.out("*v = (@n@) IDLCHECK_SEED(seed, 0);", n=name)
+        elif kind == idltype.tk_boolean:
+            st.out("*v = (seed & 1);")
+        elif kind == idltype.tk_enum:
+            st.out("*v = (@n@) (seed % @count@);", n=name, count=len(u.decl().enumerators()))
+        elif kind == idltype.tk_string:
+            st.out("*v = idlcheck_string(seed);")
+        elif kind == idltype.tk_sequence:
+            st.out("uint32_t i;")
+            st.out("v->m_size = (seed % (IDLCHECK_MAX_SEQUENCE + 1));")
+            st.out("for (i = 0; i < v->m_size; i++)")
+            st.out("  fill_@e@(&v->m_data[i], IDLCHECK_SEED(seed, i));", e=element)
+        elif kind == idltype.tk_struct:
+            self.structBody(members, "fill")
+        else:
+            sys.stderr.write("labx_check: type %s is not supported\n" % name)
+            sys.exit(1)
+        st.dec_indent()
+        st.out("}\n")
+
+        st.out("static int same_@n@(const @n@ *a, const @n@ *b)", n=name)
+        st.out("{")
+        st.inc_indent()
+        if kind in intKinds or kind == idltype.tk_enum:
+            st.out("return (*a == *b);")
+        elif kind == idltype.tk_boolean:
+            st.out("return (!*a == !*b);")
+        elif kind == idltype.tk_string:
+            st.out("return (strcmp(*a, *b) == 0);")
+        elif kind == idltype.tk_sequence:
+            st.out("uint32_t i;")
+            st.out("if (a->m_size != b->m_size)")
+            st.out("  return 0;")
+            st.out("for (i = 0; i < a->m_size; i++)")
+            st.out("  if (!same_@e@(&a->m_data[i], &b->m_data[i]))", e=element)
+            st.out("    return 0;")
+            st.out("return 1;")
+        else:
+            self.structBody(members, "same")
+        st.dec_indent()
+        st.out("}\n")
+        return name
+
+    # Fill in or compare each member of a structure, array members element
+    # by element
+    def structBody(self, members, what):
+        st = self.st
+        depth = max([0] + [len(d.sizes()) for (n, ds) in members for d in ds])
+        for i in range(depth):
+            st.out("uint32_t i@i@;", i=i)
+        k = 0
+        for (mname, decls) in members:
+            for d in decls:
+                idx = ""
+                seed = "IDLCHECK_SEED(seed, %d)" % k
+                for (i, size) in enumerate(d.sizes()):
+                    st.out("for (i@i@ = 0; i@i@ < @s@; i@i@++)", i=i, s=size)
+                    st.inc_indent()
+                    idx += "[i%d]" % i
+                    seed = "IDLCHECK_SEED(%s, i%d)" % (seed, i)
+                if what == "fill":
+                    st.out("fill_@m@(&v->@id@@idx@, @seed@);", m=mname, id=d.identifier(), idx=idx, seed=seed)
+                else:
+                    st.out("if (!same_@m@(&a->@id@@idx@, &b->@id@@idx@))", m=mname, id=d.identifier(), idx=idx)
+                    st.out("  return 0;")
+                for s in d.sizes():
+                    st.dec_indent()
+                k = k + 1
+        if what == "same":
+            st.out("return 1;")
+
+# Description of one parameter as seen by a handler or a stub of a given kind
+class Param:
+
+    def __init__(self, p, index, setter):
+        self.name = p.identifier()
+        self.type = p.paramType()
+        self.kind = self.type.unalias().kind()
+        basetype = isBasetype(self.type)
+        # Passed by pointer, as declared by labx_c's getParameterString()
+        self.pointer = (not basetype) or ((setter != eSetter) and p.is_out())
+        # Client to boot loader, and boot loader to client
+        self.input = p.is_in()
+        self.output = p.is_out() and (setter != eSetter)
+        self.inSeed = index
+        self.outSeed = OUT_SEED + index
+
+    def ref(self):
+        if self.pointer:
+            return self.name
+        return "&" + self.name
+
+class CheckTreeVisitor(idlvisitor.AstVisitor):
+
+    def visitAST(self, node):
+        for n in node.declarations():
+            n.accept(self)
+
+    def visitModule(self, node):
+        if not node.mainFile():
+            return
+
+        self.module = node.identifier()
+        self.messages = []
+        st = output.Stream(output.createFile(self.module + "_check.c"), 2)
+        self.st = st
+        self.helpers = ValueHelpers(st)
+
+        st.out("///////////////////////////////////////////////////////////////")
+        st.out("// This file is generated by the Lab X omniIDL check back-end. //")
+        st.out("// Any modifications to this file will be overwritten.       //")
+        st.out("///////////////////////////////////////////////////////////////\n")
+        st.out("#include <stdlib.h>")
+        st.out("#include <string.h>\n")
+        st.out("#include \"@m@_unmarshal.h\"", m=self.module)
+        st.out("#include \"@m@_stub.h\"", m=self.module)
+        st.out("#include \"@m@_type.h\"\n", m=self.module)
+        st.out("#include \"idlcheck.h\"\n")
+
+        for n in node.definitions():
+            if isinstance(n, idlast.Interface):
+                self.outputInterface(n)
+
+        st.out("void idlcheck_dispatch(RequestMessageBuffer_t request, ResponseMessageBuffer_t response)")
+        st.out("{")
+        st.out("  (void) @m@__unmarshal(request, response);", m=self.module)
+        st.out("}\n")
+
+        st.out("const struct idlcheck_message idlcheck_messages[] =")
+        st.out("{")
+        st.inc_indent()
+        for (name, func) in self.messages:
+            st.out("{ \"@n@\", @f@ },", n=name, f=func)
+        st.out("{ NULL, NULL }")
+        st.dec_indent()
+        st.out("};")
+        st.close()
+
+    def hasOUTParam(self, node):
+        for p in node.parameters():
+            if p.is_out():
+                return True
+        return False
+
+    def hasINOUTParam(self, node):
+        for p in node.parameters():
+            if p.is_in() and p.is_out():
+                return True
+        return False
+
+    def outputInterface(self, node):
+        iface = node.identifier()
+        for op in node.contents():
+            if "Attributes" != iface:
+                self.outputOperation(iface, op, eNone, op.identifier(), "k_SC_" + op.identifier(), "0")
+                continue
+            # Getter and setter as generated by labx_c; the one an attribute
+            # lacks must be refused
+            code = "k_AC_" + op.identifier()
+            getter = self.hasOUTParam(op) or self.hasINOUTParam(op)
+            setter = self.hasINOUTParam(op) or not self.hasOUTParam(op)
+            if getter:
+                self.outputOperation(iface, op, eGetter, "get_" + op.identifier(), "k_SC_getAttribute", code)
+            else:
+                self.outputRejected("get_" + op.identifier(), "k_SC_getAttribute", code)
+            if setter:
+                self.outputOperation(iface, op, eSetter, "set_" + op.identifier(), "k_SC_setAttribute", code)
+            else:
+                self.outputRejected("set_" + op.identifier(), "k_SC_setAttribute", code)
+
+    def returnStatus(self, op):
+        rt = op.returnType().unalias()
+        if rt.kind() == idltype.tk_enum:
+            return "(seed %% %d)" % len(rt.decl().enumerators())
+        return "0"
+
+    def outputOperation(self, iface, op, setter, fname, serviceCode, attributeCode):
+        st = self.st
+        params = []
+        for (i, p) in enumerate(op.parameters()):
+            params.append(Param(p, i, setter))
+        for p in params:
+            p.typeName = self.helpers.need(p.type)
+        rtype = typeName(op.returnType())
+        status = self.returnStatus(op)
+
+        # Output values last handed out, reused while benchmarking
+        for p in params:
+            if p.output:
+                st.out("static @t@ last_@f@_@p@;", t=p.typeName, f=fname, p=p.name)
+
+        # The handler
+        decl = []
+        for p in params:
+            ptr = ""
+            if p.pointer:
+                ptr = "*"
+            decl.append("%s %s%s" % (p.typeName, ptr, p.name))
+        st.out("@rt@ @f@(@params@)", rt=rtype, f=fname, params=", ".join(decl))
+        st.out("{")
+        st.inc_indent()
+        st.out("uint32_t seed = idlcheck_seed;")
+        for p in params:
+            if p.input:
+                st.out("@t@ expected_@p@;", t=p.typeName, p=p.name)
+        st.out("")
+        st.out("idlcheck_calls++;")
+        st.out("if (!idlcheck_bench) {")
+        st.inc_indent()
+        for p in params:
+            if p.input:
+                st.out("fill_@t@(&expected_@p@, IDLCHECK_SEED(seed, @n@));", t=p.typeName, p=p.name, n=p.inSeed)
+                st.out("if (!same_@t@(&expected_@p@, @ref@))", t=p.typeName, p=p.name, ref=p.ref())
+                st.out("  idlcheck_fail(\"@f@\", \"@p@ received\");", f=fname, p=p.name)
+        for p in params:
+            if p.output:
+                st.out("fill_@t@(@p@, IDLCHECK_SEED(seed, @n@));", t=p.typeName, p=p.name, n=p.outSeed)
+                st.out("last_@f@_@p@ = *@p@;", f=fname, p=p.name)
+        st.dec_indent()
+        if [p for p in params if p.output]:
+            st.out("} else {")
+            st.inc_indent()
+            for p in params:
+                if p.output:
+                    st.out("*@p@ = last_@f@_@p@;", f=fname, p=p.name)
+            st.dec_indent()
+        st.out("}")
+        # Strings are allocated by the unmarshal code
+        for p in params:
+            if p.input and not p.output and (p.kind == idltype.tk_string):
+                st.out("free(@p@);", p=p.name)
+        st.out("return (@rt@) @status@;", rt=rtype, status=status)
+        st.dec_indent()
+        st.out("}\n")
+
+        # The check
+        func = "check_" + fname
+        st.out("static void @func@(uint32_t seed)", func=func)
+        st.out("{")
+        st.inc_indent()
+        st.out("ResponseMessageBuffer_t expected;")
+        st.out("uint32_t offset = RESP_PAYLOAD_OFFSET;")
+        st.out("@rt@ status;", rt=rtype)
+        for p in params:
+            st.out("@t@ @p@;", t=p.typeName, p=p.name)
+            if p.output:
+                st.out("@t@ expected_@p@;", t=p.typeName, p=p.name)
+        st.out("")
+        st.out("idlcheck_seed = seed;")
+        st.out("idlcheck_calls = 0;")
+        for p in params:
+            if p.input:
+                st.out("fill_@t@(&@p@, IDLCHECK_SEED(seed, @n@));", t=p.typeName, p=p.name, n=p.inSeed)
+        args = []
+        for p in params:
+            if p.pointer:
+                args.append("&" + p.name)
+            else:
+                args.append(p.name)
+        st.out("status = @iface@_stub_@f@(@args@);", iface=iface, f=fname, args=", ".join(args))
+        st.out("")
+        st.out("if (idlcheck_calls != 1)")
+        st.out("  idlcheck_fail(\"@f@\", \"handler calls\");", f=fname)
+        st.out("if (status != (@rt@) @status@)", rt=rtype, status=status)
+        st.out("  idlcheck_fail(\"@f@\", \"status\");", f=fname)
+        for p in params:
+            if p.output:
+                st.out("fill_@t@(&expected_@p@, IDLCHECK_SEED(seed, @n@));", t=p.typeName, p=p.name, n=p.outSeed)
+                st.out("if (!same_@t@(&expected_@p@, &@p@))", t=p.typeName, p=p.name)
+                st.out("  idlcheck_fail(\"@f@\", \"@p@ returned\");", f=fname, p=p.name)
+                st.out("offset += @t@_marshal(expected, offset, &expected_@p@);", t=p.typeName, p=p.name)
+                if p.kind == idltype.tk_string:
+                    st.out("free(@p@);", p=p.name)
+        st.out("idlcheck_response(\"@f@\", expected, offset);", f=fname)
+        st.dec_indent()
+        st.out("}\n")
+        self.messages.append((fname, func))
+
+    def outputRejected(self, fname, serviceCode, attributeCode):
+        st = self.st
+        func = "check_" + fname + "_refused"
+        st.out("static void @func@(uint32_t seed)", func=func)
+        st.out("{")
+        st.out("  idlcheck_refused(\"@f@\", @sc@, @ac@, e_EC_INVALID_ATTRIBUTE_CODE);",
+               f=fname, sc=serviceCode, ac=attributeCode)
+        st.out("}\n")
+        self.messages.append((fname + " (refused)", func))
+
+def run(tree, args):
+    visitor = CheckTreeVisitor()
+    tree.accept(visitor)
+
+# vi:set ai sw=4 expandtab ts=4:
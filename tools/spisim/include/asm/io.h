@@ -0,0 +1,16 @@
+/*
+ * MMIO accessors for the simulator build: every register access made by
+ * the drivers goes to the modeled Xilinx SPI core and costs modeled time.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __SPISIM_ASM_IO_H__
+#define __SPISIM_ASM_IO_H__
+
+#include "../../spisim.h"
+
+#define readl(addr)		xspi_model_read((unsigned long)(addr))
+#define writel(val, addr)	xspi_model_write((val), (unsigned long)(addr))
+
+#endif /* __SPISIM_ASM_IO_H__ */
@@ -0,0 +1,45 @@
+/*
+ * Minimal <common.h> for building the U-Boot SPI flash drivers into the
+ * host-side simulator.  Only what those drivers use is provided; timing
+ * services run on modeled time rather than the host clock.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __SPISIM_COMMON_H__
+#define __SPISIM_COMMON_H__
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <linux/types.h>
+
+#define CONFIG_SYS_HZ		1000
+
+#ifdef DEBUG
+#define debug(fmt,args...)	printf (fmt ,##args)
+#else
+#define debug(fmt,args...)
+#endif
+
+#define min(X, Y)				\
+	({ typeof (X) __x = (X), __y = (Y);	\
+		(__x < __y) ? __x : __y; })
+
+#define max(X, Y)				\
+	({ typeof (X) __x = (X), __y = (Y);	\
+		(__x > __y) ? __x : __y; })
+
+#define container_of(ptr, type, member) ({			\
+	const typeof( ((type *)0)->member ) *__mptr = (ptr);	\
+	(type *)( (char *)__mptr - offsetof(type,member) );})
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+#define roundup(x, y)		((((x) + ((y) - 1)) / (y)) * (y))
+
+ulong	get_timer (ulong base);
+void	udelay (unsigned long usec);
+
+#endif /* __SPISIM_COMMON_H__ */
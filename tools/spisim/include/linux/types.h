@@ -0,0 +1,20 @@
+/*
+ * Fixed-size types for the simulator build of the SPI flash drivers.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __SPISIM_LINUX_TYPES_H__
+#define __SPISIM_LINUX_TYPES_H__
+
+#include <stdint.h>
+#include <sys/types.h>
+
+typedef unsigned char	uchar;
+
+typedef uint8_t		u8;
+typedef uint16_t	u16;
+typedef uint32_t	u32;
+typedef uint64_t	u64;
+
+#endif /* __SPISIM_LINUX_TYPES_H__ */
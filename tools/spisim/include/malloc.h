@@ -0,0 +1,12 @@
+/*
+ * The simulator allocates from the host heap.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __SPISIM_MALLOC_H__
+#define __SPISIM_MALLOC_H__
+
+#include <stdlib.h>
+
+#endif /* __SPISIM_MALLOC_H__ */
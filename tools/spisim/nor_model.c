@@ -0,0 +1,336 @@
+/*
+ * Model of a JEDEC SPI NOR flash: READ ID, status, write enable/disable,
+ * normal and fast array reads, page program and the erase commands of
+ * each part, with typical datasheet program and erase times.  The write-
+ * in-progress bit stays set for that long after a program or erase.
+ *
+ * Anything a real part would reject or silently mishandle (commands while
+ * busy, programs without write enable, programming bits which are not
+ * erased) is reported as a violation.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spisim.h"
+
+#define CMD_WRSR		0x01
+#define CMD_PP			0x02
+#define CMD_READ		0x03
+#define CMD_WRDI		0x04
+#define CMD_RDSR		0x05
+#define CMD_WREN		0x06
+#define CMD_FAST_READ		0x0b
+#define CMD_RDID		0x9f
+
+#define SR_WIP			0x01
+#define SR_WEL			0x02
+
+#define MAX_ERASE_OPS		3
+
+struct nor_erase {
+	uint8_t		opcode;
+	uint32_t	size;
+	unsigned int	time_ms;
+};
+
+struct nor_part {
+	const char	*name;
+	uint8_t		id[5];
+	uint32_t	size;
+	uint32_t	page_size;
+	unsigned int	program_us;	/* one full page */
+	struct nor_erase erase[MAX_ERASE_OPS];
+	struct nor_erase chip_erase;
+};
+
+static const struct nor_part nor_parts[] = {
+	{
+		.name		= "s25fl128p",
+		.id		= { 0x01, 0x20, 0x18, 0x03, 0x01 },
+		.size		= 16 << 20,
+		.page_size	= 256,
+		.program_us	= 1500,
+		.erase		= { { 0xd8, 64 << 10, 500 } },
+		.chip_erase	= { 0xc7, 16 << 20, 128000 },
+	},
+	{
+		.name		= "m25p128",
+		.id		= { 0x20, 0x20, 0x18, 0x00, 0x00 },
+		.size		= 16 << 20,
+		.page_size	= 256,
+		.program_us	= 1400,
+		.erase		= { { 0xd8, 256 << 10, 2000 } },
+		.chip_erase	= { 0xc7, 16 << 20, 105000 },
+	},
+	{
+		.name		= "w25x64",
+		.id		= { 0xef, 0x30, 0x17, 0x00, 0x00 },
+		.size		= 8 << 20,
+		.page_size	= 256,
+		.program_us	= 1500,
+		.erase		= { { 0x20, 4 << 10, 150 },
+				    { 0xd8, 64 << 10, 1000 } },
+		.chip_erase	= { 0xc7, 8 << 20, 40000 },
+	},
+};
+
+static const struct nor_part *part;
+static uint8_t *array;
+static uint8_t *page_buf;
+static uint8_t *page_set;		/* bytes of page_buf clocked in */
+
+static int selected;
+static uint8_t opcode;
+static int ignored;			/* command rejected at its opcode */
+static unsigned int nbytes;		/* bytes clocked in this command */
+static uint32_t addr;
+static int wel;
+static unsigned long long busy_until;
+
+void nor_model_list(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(nor_parts) / sizeof(nor_parts[0]); i++)
+		printf("  %-10s %5u KiB, ID %02x %02x %02x\n",
+			nor_parts[i].name, nor_parts[i].size >> 10,
+			nor_parts[i].id[0], nor_parts[i].id[1],
+			nor_parts[i].id[2]);
+}
+
+int nor_model_init(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < sizeof(nor_parts) / sizeof(nor_parts[0]); i++) {
+		if (strcmp(nor_parts[i].name, name) == 0)
+			break;
+	}
+	if (i == sizeof(nor_parts) / sizeof(nor_parts[0]))
+		return -1;
+
+	part = &nor_parts[i];
+	array = malloc(part->size);
+	page_buf = malloc(part->page_size);
+	page_set = malloc(part->page_size);
+	if (!array || !page_buf || !page_set)
+		return -1;
+
+	/* Parts ship erased */
+	memset(array, 0xff, part->size);
+	return 0;
+}
+
+const uint8_t *nor_model_array(void)
+{
+	return array;
+}
+
+uint32_t nor_model_size(void)
+{
+	return part->size;
+}
+
+const char *nor_model_name(void)
+{
+	return part->name;
+}
+
+static int nor_busy(void)
+{
+	return sim_now < busy_until;
+}
+
+static void nor_start_busy(unsigned long long ns)
+{
+	busy_until = sim_now + ns;
+	sim_stats.busy_ns += ns;
+	wel = 0;
+}
+
+static const struct nor_erase *nor_erase_op(uint8_t op)
+{
+	unsigned int i;
+
+	for (i = 0; i < MAX_ERASE_OPS && part->erase[i].size; i++) {
+		if (part->erase[i].opcode == op)
+			return &part->erase[i];
+	}
+	if (part->chip_erase.opcode == op)
+		return &part->chip_erase;
+	return NULL;
+}
+
+static void nor_program(void)
+{
+	uint32_t base = addr & ~(part->page_size - 1);
+	unsigned int col, count = 0;
+	int unerased = 0;
+
+	for (col = 0; col < part->page_size; col++) {
+		if (!page_set[col])
+			continue;
+		if (page_buf[col] & ~array[base + col])
+			unerased = 1;
+		array[base + col] &= page_buf[col];
+		count++;
+	}
+	if (unerased)
+		sim_violation("page program at 0x%06x over unerased bits",
+			base);
+
+	sim_stats.program_bytes += count;
+	nor_start_busy(part->program_us * 1000ULL);
+}
+
+static void nor_erase(const struct nor_erase *op)
+{
+	uint32_t start = 0;
+
+	if (op != &part->chip_erase)
+		start = addr & ~(op->size - 1);
+
+	memset(array + start, 0xff, op->size);
+	sim_stats.erase_bytes += op->size;
+	nor_start_busy(op->time_ms * 1000000ULL);
+}
+
+/* Carry out a command when chip select goes inactive */
+static void nor_finish(void)
+{
+	const struct nor_erase *op;
+
+	if (ignored || nbytes == 0)
+		return;
+
+	switch (opcode) {
+	case CMD_WREN:
+		wel = 1;
+		break;
+	case CMD_WRDI:
+		wel = 0;
+		break;
+	case CMD_PP:
+		if (nbytes < 5) {
+			sim_violation("page program with no data");
+		} else if (!wel) {
+			sim_violation("page program without write enable");
+		} else {
+			nor_program();
+		}
+		break;
+	default:
+		op = nor_erase_op(opcode);
+		if (!op)
+			break;
+		if (op != &part->chip_erase && nbytes != 4) {
+			sim_violation("erase %02x with %u address bytes",
+				opcode, nbytes - 1);
+		} else if (!wel) {
+			sim_violation("erase without write enable");
+		} else {
+			nor_erase(op);
+		}
+		break;
+	}
+}
+
+void nor_model_select(int sel)
+{
+	if (sel == selected)
+		return;
+
+	if (!sel)
+		nor_finish();
+
+	selected = sel;
+	nbytes = 0;
+	ignored = 0;
+}
+
+static void nor_count_command(void)
+{
+	switch (opcode) {
+	case CMD_READ:
+	case CMD_FAST_READ:
+		sim_stats.cmd_read++;
+		break;
+	case CMD_PP:
+		sim_stats.cmd_program++;
+		break;
+	case CMD_RDSR:
+		sim_stats.cmd_status++;
+		break;
+	default:
+		if (nor_erase_op(opcode))
+			sim_stats.cmd_erase++;
+		else
+			sim_stats.cmd_other++;
+		break;
+	}
+}
+
+uint8_t nor_model_xfer(uint8_t mosi)
+{
+	unsigned int n = nbytes++;
+	unsigned int col;
+
+	if (!selected)
+		return 0xff;
+
+	if (n == 0) {
+		opcode = mosi;
+		nor_count_command();
+		if (nor_busy() && opcode != CMD_RDSR) {
+			sim_violation("command %02x while busy", opcode);
+			ignored = 1;
+		}
+		if (opcode == CMD_PP)
+			memset(page_set, 0, part->page_size);
+		return 0xff;
+	}
+
+	if (ignored)
+		return 0xff;
+
+	/* Bytes 1-3 of addressed commands are the address, MSB first */
+	if (n <= 3 && opcode != CMD_RDID && opcode != CMD_RDSR) {
+		addr = ((addr << 8) | mosi) & 0xffffff;
+		if (n == 3)
+			addr %= part->size;
+		return 0xff;
+	}
+
+	switch (opcode) {
+	case CMD_RDID:
+		return (n <= 5) ? part->id[n - 1] : 0xff;
+
+	case CMD_RDSR:
+		return (nor_busy() ? SR_WIP : 0) | (wel ? SR_WEL : 0);
+
+	case CMD_FAST_READ:
+		if (n == 4)
+			return 0xff;	/* dummy byte */
+		/* fall through */
+	case CMD_READ:
+		sim_stats.read_bytes++;
+		mosi = array[addr];
+		addr = (addr + 1) % part->size;
+		return mosi;
+
+	case CMD_PP:
+		/* The column wraps within the page, as on the real part */
+		col = ((addr & (part->page_size - 1)) + n - 4) %
+			part->page_size;
+		page_buf[col] = mosi;
+		page_set[col] = 1;
+		return 0xff;
+
+	default:
+		return 0xff;
+	}
+}
@@ -0,0 +1,309 @@
+/*
+ * spisim - run the U-Boot Xilinx SPI and SPI flash drivers against a
+ * model of the xps_spi core and a JEDEC NOR flash, and report what each
+ * flash operation costs on the bus and in modeled time.
+ *
+ * The workload is the one the boot loader performs on the flash: probe,
+ * erase a region, program it, read it back, then CRC it in chunks the
+ * way the preboot image check does.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <common.h>
+#include <spi_flash.h>
+
+#include "spisim.h"
+
+uint32_t crc32(uint32_t crc, const unsigned char *buf, unsigned int len);
+
+#define NUM_STATS	(sizeof(struct sim_stats) / sizeof(unsigned long long))
+
+struct phase {
+	const char		*name;
+	unsigned long long	start_ns;
+	unsigned long long	elapsed_ns;
+	unsigned long long	bytes;
+	struct sim_stats	start;
+	struct sim_stats	delta;
+};
+
+static int verbose;
+
+/*
+ * Timing services for the drivers.  Time only moves when the CPU touches
+ * the controller or waits, which is all a polled driver does.
+ */
+ulong get_timer(ulong base)
+{
+	return (ulong)(sim_now / 1000000ULL) - base;
+}
+
+void udelay(unsigned long usec)
+{
+	sim_advance(usec * 1000ULL);
+}
+
+void sim_violation(const char *fmt, ...)
+{
+	va_list args;
+
+	sim_stats.violations++;
+	if (sim_stats.violations > 20 && !verbose)
+		return;
+
+	fprintf(stderr, "spisim: %10.3f ms: ", sim_now / 1e6);
+	va_start(args, fmt);
+	vfprintf(stderr, fmt, args);
+	va_end(args);
+	fputc('\n', stderr);
+}
+
+static void phase_begin(struct phase *p, const char *name,
+		unsigned long long bytes)
+{
+	p->name = name;
+	p->bytes = bytes;
+	p->start_ns = sim_now;
+	p->start = sim_stats;
+}
+
+static void phase_end(struct phase *p)
+{
+	unsigned long long *now = (unsigned long long *)&sim_stats;
+	unsigned long long *start = (unsigned long long *)&p->start;
+	unsigned long long *delta = (unsigned long long *)&p->delta;
+	unsigned int i;
+
+	for (i = 0; i < NUM_STATS; i++)
+		delta[i] = now[i] - start[i];
+	p->elapsed_ns = sim_now - p->start_ns;
+}
+
+static void phase_report(const struct phase *p)
+{
+	const struct sim_stats *d = &p->delta;
+	double ms = p->elapsed_ns / 1e6;
+
+	printf("%-8s %12.3f ms", p->name, ms);
+	if (p->bytes && p->elapsed_ns)
+		printf("  %9.1f KiB/s", p->bytes / 1024.0 / (p->elapsed_ns / 1e9));
+	printf("\n");
+	printf("         %llu transactions, %llu bus bytes, "
+		"%llu register reads, %llu register writes\n",
+		d->transactions, d->bus_bytes, d->reg_reads, d->reg_writes);
+	printf("         commands: %llu read, %llu program, %llu erase, "
+		"%llu status, %llu other\n",
+		d->cmd_read, d->cmd_program, d->cmd_erase, d->cmd_status,
+		d->cmd_other);
+	printf("         array: %llu read, %llu programmed, %llu erased; "
+		"flash busy %.3f ms\n",
+		d->read_bytes, d->program_bytes, d->erase_bytes,
+		d->busy_ns / 1e6);
+	if (d->violations)
+		printf("         %llu violations\n", d->violations);
+}
+
+/* Deterministic test pattern, so runs can be compared */
+static void fill_pattern(uint8_t *buf, size_t len)
+{
+	uint32_t x = 0x2545f491;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		buf[i] = x >> 24;
+	}
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [options]\n"
+		"  -p part       flash part to model (default s25fl128p)\n"
+		"  -s hz         SPI clock (default 25000000)\n"
+		"  -a ns         CPU cost of one core register access (default 100)\n"
+		"  -o offset     flash offset of the test region (default 0)\n"
+		"  -l length     length of the test region (default 0x40000)\n"
+		"  -k chunk      read chunk of the CRC pass (default 0x4000)\n"
+		"  -c ns         CPU cost of CRC-32 per byte (default 0)\n"
+		"  -v            report every violation\n"
+		"  -L            list the modeled parts\n",
+		prog);
+}
+
+int main(int argc, char **argv)
+{
+	const char *part_name = "s25fl128p";
+	unsigned int sck_hz = 25000000;
+	unsigned int access_ns = 100;
+	unsigned int crc_ns = 0;
+	unsigned long offset = 0;
+	unsigned long len = 0x40000;
+	unsigned long chunk = 0x4000;
+	unsigned long erase_len, pos, n;
+	struct spi_flash *flash;
+	struct phase phases[5];
+	unsigned int num_phases = 0, i;
+	uint8_t *pattern, *buf;
+	uint32_t crc, expected_crc;
+	int failed = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "p:s:a:o:l:k:c:vLh")) != -1) {
+		switch (opt) {
+		case 'p':
+			part_name = optarg;
+			break;
+		case 's':
+			sck_hz = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			access_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 'o':
+			offset = strtoul(optarg, NULL, 0);
+			break;
+		case 'l':
+			len = strtoul(optarg, NULL, 0);
+			break;
+		case 'k':
+			chunk = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			crc_ns = strtoul(optarg, NULL, 0);
+			break;
+		case 'v':
+			verbose = 1;
+			break;
+		case 'L':
+			nor_model_list();
+			return 0;
+		default:
+			usage(argv[0]);
+			return opt == 'h' ? 0 : 1;
+		}
+	}
+
+	if (!sck_hz || !len || !chunk) {
+		usage(argv[0]);
+		return 1;
+	}
+	if (nor_model_init(part_name) != 0) {
+		fprintf(stderr, "%s: unknown part '%s'; parts are:\n",
+			argv[0], part_name);
+		nor_model_list();
+		return 1;
+	}
+	if (offset + len > nor_model_size()) {
+		fprintf(stderr, "%s: region exceeds the %u byte %s\n",
+			argv[0], nor_model_size(), nor_model_name());
+		return 1;
+	}
+
+	xspi_model_init(sck_hz, access_ns);
+
+	pattern = malloc(len);
+	buf = malloc(len);
+	if (!pattern || !buf) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return 1;
+	}
+	fill_pattern(pattern, len);
+	expected_crc = crc32(0, pattern, len);
+
+	printf("%s, SCK %u Hz, %u ns per register access, "
+		"region 0x%lx+0x%lx\n\n",
+		nor_model_name(), sck_hz, access_ns, offset, len);
+
+	/* Probe */
+	phase_begin(&phases[num_phases], "probe", 0);
+	flash = spi_flash_probe(0, 0, sck_hz, SPI_MODE_3);
+	phase_end(&phases[num_phases++]);
+	if (!flash) {
+		fprintf(stderr, "%s: probe failed\n", argv[0]);
+		return 1;
+	}
+
+	if (offset % flash->sector_size) {
+		fprintf(stderr, "%s: offset is not a multiple of the %u byte "
+			"erase sector\n", argv[0], flash->sector_size);
+		return 1;
+	}
+	erase_len = roundup(len, flash->sector_size);
+	if (offset + erase_len > flash->size)
+		erase_len = flash->size - offset;
+
+	/* Erase */
+	phase_begin(&phases[num_phases], "erase", erase_len);
+	if (spi_flash_erase(flash, offset, erase_len) != 0) {
+		fprintf(stderr, "%s: erase failed\n", argv[0]);
+		failed = 1;
+	}
+	phase_end(&phases[num_phases++]);
+
+	/* Program */
+	phase_begin(&phases[num_phases], "program", len);
+	if (spi_flash_write(flash, offset, len, pattern) != 0) {
+		fprintf(stderr, "%s: program failed\n", argv[0]);
+		failed = 1;
+	}
+	phase_end(&phases[num_phases++]);
+
+	/* Read back in one request */
+	phase_begin(&phases[num_phases], "read", len);
+	if (spi_flash_read(flash, offset, len, buf) != 0) {
+		fprintf(stderr, "%s: read failed\n", argv[0]);
+		failed = 1;
+	} else if (memcmp(buf, pattern, len) != 0) {
+		fprintf(stderr, "%s: data read back differs\n", argv[0]);
+		failed = 1;
+	}
+	phase_end(&phases[num_phases++]);
+
+	/* CRC verify, streamed in chunks as check_crcs() does */
+	phase_begin(&phases[num_phases], "verify", len);
+	crc = 0;
+	for (pos = 0; pos < len; pos += n) {
+		n = min(chunk, len - pos);
+		if (spi_flash_read(flash, offset + pos, n, buf) != 0) {
+			fprintf(stderr, "%s: read failed\n", argv[0]);
+			failed = 1;
+			break;
+		}
+		crc = crc32(crc, buf, n);
+		sim_advance((unsigned long long)crc_ns * n);
+	}
+	phase_end(&phases[num_phases++]);
+	if (crc != expected_crc) {
+		fprintf(stderr, "%s: CRC 0x%08x, expected 0x%08x\n",
+			argv[0], crc, expected_crc);
+		failed = 1;
+	}
+
+	/* The array itself must hold the pattern, whatever the reads said */
+	if (memcmp(nor_model_array() + offset, pattern, len) != 0) {
+		fprintf(stderr, "%s: flash array differs from the pattern\n",
+			argv[0]);
+		failed = 1;
+	}
+
+	for (i = 0; i < num_phases; i++)
+		phase_report(&phases[i]);
+	printf("\ntotal    %12.3f ms, %llu violations\n",
+		sim_now / 1e6, sim_stats.violations);
+
+	spi_flash_free(flash);
+	free(pattern);
+	free(buf);
+
+	return (failed || sim_stats.violations) ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+/*
+ * Host-side simulation of a Xilinx xps_spi controller and a JEDEC SPI NOR
+ * flash, against which the U-Boot SPI and SPI flash drivers run unchanged.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#ifndef __SPISIM_H__
+#define __SPISIM_H__
+
+#include <stdint.h>
+
+/* Modeled time since the simulation started, in nanoseconds */
+extern unsigned long long sim_now;
+
+/* Base address the simulated controller decodes */
+#define SPISIM_XSPI_BASE	0x40000000UL
+#define SPISIM_XSPI_SIZE	0x80UL
+
+struct sim_stats {
+	/* Controller */
+	unsigned long long	reg_reads;	/* CPU reads of core registers	*/
+	unsigned long long	reg_writes;	/* CPU writes of core registers	*/
+	unsigned long long	transactions;	/* chip select assertions	*/
+	unsigned long long	bus_bytes;	/* bytes shifted on the bus	*/
+	unsigned long long	tx_overruns;	/* writes to a full TX FIFO	*/
+	unsigned long long	rx_overruns;	/* bytes lost to a full RX FIFO	*/
+	unsigned long long	rx_underruns;	/* reads of an empty RX FIFO	*/
+
+	/* Flash */
+	unsigned long long	cmd_read;	/* array read commands		*/
+	unsigned long long	cmd_program;	/* page program commands	*/
+	unsigned long long	cmd_erase;	/* sector, block or chip erases	*/
+	unsigned long long	cmd_status;	/* status register reads	*/
+	unsigned long long	cmd_other;
+	unsigned long long	read_bytes;	/* array bytes read out		*/
+	unsigned long long	program_bytes;	/* array bytes programmed	*/
+	unsigned long long	erase_bytes;	/* array bytes erased		*/
+	unsigned long long	busy_ns;	/* time spent programming/erasing */
+	unsigned long long	violations;	/* protocol errors, see log	*/
+};
+
+extern struct sim_stats sim_stats;
+
+/* Advance modeled time, completing any bus activity due by then */
+void sim_advance(unsigned long long ns);
+
+/* Xilinx xps_spi register file */
+void xspi_model_init(unsigned int sck_hz, unsigned int access_ns);
+uint32_t xspi_model_read(unsigned long addr);
+void xspi_model_write(uint32_t val, unsigned long addr);
+
+/* JEDEC SPI NOR flash on chip select 0 */
+int nor_model_init(const char *part);
+void nor_model_list(void);
+void nor_model_select(int selected);
+uint8_t nor_model_xfer(uint8_t mosi);
+const uint8_t *nor_model_array(void);
+uint32_t nor_model_size(void);
+const char *nor_model_name(void);
+
+/* Report a protocol error seen by a model */
+void sim_violation(const char *fmt, ...)
+	__attribute__ ((format (__printf__, 1, 2)));
+
+#endif /* __SPISIM_H__ */
@@ -0,0 +1,238 @@
+/*
+ * Model of the Xilinx xps_spi core in master mode with manual slave
+ * select, as driven by drivers/spi/xilinx_spi.c.
+ *
+ * Every register access costs a fixed bus latency.  While the core is
+ * enabled and its TX FIFO holds data, bytes are shifted back to back at
+ * eight SCK periods each; each byte goes to the flash model if it is
+ * selected, and the byte returned lands in the RX FIFO.
+ *
+ * Licensed under the GPL-2 or later.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "spisim.h"
+
+#ifndef CONFIG_XILINX_SPI_FIFO_DEPTH
+#define CONFIG_XILINX_SPI_FIFO_DEPTH	16
+#endif
+#define FIFO_DEPTH	CONFIG_XILINX_SPI_FIFO_DEPTH
+
+/* Register offsets */
+#define XSPI_SRR	0x40	/* software reset */
+#define XSPI_CR		0x60	/* control */
+#define XSPI_SR		0x64	/* status */
+#define XSPI_TR		0x68	/* transmit data */
+#define XSPI_RR		0x6c	/* receive data */
+#define XSPI_SSR	0x70	/* slave select */
+#define XSPI_TX_OCY	0x74	/* transmit FIFO occupancy, minus one */
+#define XSPI_RX_OCY	0x78	/* receive FIFO occupancy, minus one */
+
+#define XSPI_SRR_RESET		0x0a
+
+#define XSPI_CR_SPE		0x002
+#define XSPI_CR_MASTER		0x004
+#define XSPI_CR_TX_RESET	0x020
+#define XSPI_CR_RX_RESET	0x040
+#define XSPI_CR_INHIBIT		0x100
+
+#define XSPI_SR_RX_EMPTY	0x01
+#define XSPI_SR_RX_FULL		0x02
+#define XSPI_SR_TX_EMPTY	0x04
+#define XSPI_SR_TX_FULL		0x08
+
+struct fifo {
+	uint8_t		data[FIFO_DEPTH];
+	unsigned int	head;
+	unsigned int	count;
+};
+
+static uint32_t cr;
+static uint32_t ssr;
+static struct fifo tx, rx;
+
+static int shifting;			/* a byte is in the shift register */
+static uint8_t shift_out;
+static unsigned long long shift_done;	/* when that byte completes */
+
+static unsigned long long byte_ns;
+static unsigned int access_ns;
+
+unsigned long long sim_now;
+struct sim_stats sim_stats;
+
+static void fifo_push(struct fifo *f, uint8_t val)
+{
+	f->data[(f->head + f->count) % FIFO_DEPTH] = val;
+	f->count++;
+}
+
+static uint8_t fifo_pop(struct fifo *f)
+{
+	uint8_t val = f->data[f->head];
+
+	f->head = (f->head + 1) % FIFO_DEPTH;
+	f->count--;
+	return val;
+}
+
+static int xspi_can_shift(void)
+{
+	return (cr & XSPI_CR_SPE) && (cr & XSPI_CR_MASTER) &&
+		!(cr & XSPI_CR_INHIBIT);
+}
+
+static void xspi_start_shift(unsigned long long when)
+{
+	shift_out = fifo_pop(&tx);
+	shift_done = when + byte_ns;
+	shifting = 1;
+}
+
+static void xspi_complete_shift(void)
+{
+	uint8_t miso = 0xff;
+
+	/* The flash sits on slave select 0, active low */
+	if (!(ssr & 1))
+		miso = nor_model_xfer(shift_out);
+
+	sim_stats.bus_bytes++;
+	shifting = 0;
+
+	if (rx.count == FIFO_DEPTH) {
+		sim_stats.rx_overruns++;
+		sim_violation("RX FIFO overrun");
+		return;
+	}
+	fifo_push(&rx, miso);
+}
+
+void sim_advance(unsigned long long ns)
+{
+	unsigned long long target = sim_now + ns;
+
+	while (shifting && shift_done <= target) {
+		sim_now = shift_done;
+		xspi_complete_shift();
+		if (tx.count && xspi_can_shift())
+			xspi_start_shift(sim_now);
+	}
+	sim_now = target;
+}
+
+static void xspi_kick(void)
+{
+	if (!shifting && tx.count && xspi_can_shift())
+		xspi_start_shift(sim_now);
+}
+
+static void xspi_reset(void)
+{
+	cr = 0x180;	/* manual slave select, transfers inhibited */
+	ssr = ~0;
+	memset(&tx, 0, sizeof(tx));
+	memset(&rx, 0, sizeof(rx));
+	shifting = 0;
+}
+
+void xspi_model_init(unsigned int sck_hz, unsigned int bus_access_ns)
+{
+	byte_ns = (8ULL * 1000000000ULL + sck_hz - 1) / sck_hz;
+	access_ns = bus_access_ns;
+	xspi_reset();
+}
+
+uint32_t xspi_model_read(unsigned long addr)
+{
+	uint32_t val = 0;
+
+	sim_advance(access_ns);
+	sim_stats.reg_reads++;
+
+	switch (addr - SPISIM_XSPI_BASE) {
+	case XSPI_CR:
+		val = cr;
+		break;
+	case XSPI_SR:
+		if (rx.count == 0)
+			val |= XSPI_SR_RX_EMPTY;
+		if (rx.count == FIFO_DEPTH)
+			val |= XSPI_SR_RX_FULL;
+		if (tx.count == 0)
+			val |= XSPI_SR_TX_EMPTY;
+		if (tx.count == FIFO_DEPTH)
+			val |= XSPI_SR_TX_FULL;
+		break;
+	case XSPI_RR:
+		if (rx.count == 0) {
+			sim_stats.rx_underruns++;
+			sim_violation("read of empty RX FIFO");
+			break;
+		}
+		val = fifo_pop(&rx);
+		break;
+	case XSPI_SSR:
+		val = ssr;
+		break;
+	case XSPI_TX_OCY:
+		val = tx.count ? tx.count - 1 : 0;
+		break;
+	case XSPI_RX_OCY:
+		val = rx.count ? rx.count - 1 : 0;
+		break;
+	default:
+		sim_violation("read of unmodeled register 0x%lx", addr);
+		break;
+	}
+
+	return val;
+}
+
+void xspi_model_write(uint32_t val, unsigned long addr)
+{
+	sim_advance(access_ns);
+	sim_stats.reg_writes++;
+
+	switch (addr - SPISIM_XSPI_BASE) {
+	case XSPI_SRR:
+		if (val == XSPI_SRR_RESET) {
+			if (!(ssr & 1))
+				nor_model_select(0);
+			xspi_reset();
+		}
+		break;
+	case XSPI_CR:
+		if (val & XSPI_CR_TX_RESET)
+			memset(&tx, 0, sizeof(tx));
+		if (val & XSPI_CR_RX_RESET)
+			memset(&rx, 0, sizeof(rx));
+		cr = val & ~(XSPI_CR_TX_RESET | XSPI_CR_RX_RESET);
+		xspi_kick();
+		break;
+	case XSPI_TR:
+		if (tx.count == FIFO_DEPTH) {
+			sim_stats.tx_overruns++;
+			sim_violation("TX FIFO overrun");
+			break;
+		}
+		fifo_push(&tx, val);
+		xspi_kick();
+		break;
+	case XSPI_SSR:
+		if ((ssr ^ val) & 1) {
+			if (shifting || tx.count)
+				sim_violation("slave select changed mid-byte");
+			if (!(val & 1))
+				sim_stats.transactions++;
+			nor_model_select(!(val & 1));
+		}
+		ssr = val;
+		break;
+	default:
+		sim_violation("write of unmodeled register 0x%lx", addr);
+		break;
+	}
+}